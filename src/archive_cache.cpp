@@ -0,0 +1,311 @@
+// ARCHIVE CACHE ////////////////////////////////////////////////////////////////////////
+static u64 archive_cache_hash( const char *url )
+{
+	// FNV-1a
+	u64 hash = 0xcbf29ce484222325ull;
+
+	for ( const u8 *c = (const u8 *)url; *c; ++c )
+	{
+		hash ^= *c;
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static void archive_cache_path( char *path, const char *cacheFolder, const char *key, const char *ext )
+{
+	string_utf8_format( path, ARCHIVE_CACHE_MAX_PATH, "%s%s%s%s", cacheFolder, ARCHIVE_CACHE_FOLDER, key, ext );
+}
+
+static bool archive_cache_read_meta( const char *metaPath, ArchiveCacheEntry *entry )
+{
+	FILE *file = fopen( metaPath, "rb" );
+	if ( !file )
+		return false;
+
+	char line[ ARCHIVE_CACHE_MAX_PATH + 32 ];
+	bool hasSize = false;
+
+	while ( fgets( line, sizeof( line ), file ) )
+	{
+		char *end = line + string_utf8_bytes( line ) - 1;
+		while ( end > line && ( end[ -1 ] == '\n' || end[ -1 ] == '\r' ) )
+			*--end = '\0';
+
+		char *value = line;
+		while ( *value && *value != ' ' )
+			++value;
+
+		if ( *value == '\0' )
+			continue;
+
+		*value++ = '\0';
+
+		if ( string_utf8_compare( line, "url" ) )
+		{
+			string_utf8_copy( entry->url, value );
+		}
+		else if ( string_utf8_compare( line, "etag" ) )
+		{
+			string_utf8_copy( entry->validators.etag, value );
+		}
+		else if ( string_utf8_compare( line, "last-modified" ) )
+		{
+			string_utf8_copy( entry->validators.lastModified, value );
+		}
+		else if ( string_utf8_compare( line, "size" ) )
+		{
+			entry->size = convert_to_u64( value );
+			hasSize = true;
+		}
+		else if ( string_utf8_compare( line, "used" ) )
+		{
+			entry->lastUsed = convert_to_u64( value );
+		}
+	}
+
+	fclose( file );
+
+	return hasSize;
+}
+
+// Written beside the old one and renamed over it, a crash leaves either the old or the new metadata
+static bool archive_cache_write_meta( const ArchiveCacheEntry *entry )
+{
+	char tempPath[ ARCHIVE_CACHE_MAX_PATH ];
+	string_utf8_format( tempPath, "%s.tmp", entry->metaPath );
+
+	FILE *file = fopen( tempPath, "wb" );
+	if ( !file )
+		return false;
+
+	fprintf( file, "url %s\n", entry->url );
+
+	if ( entry->validators.etag[ 0 ] )
+		fprintf( file, "etag %s\n", entry->validators.etag );
+
+	if ( entry->validators.lastModified[ 0 ] )
+		fprintf( file, "last-modified %s\n", entry->validators.lastModified );
+
+	fprintf( file, "size %llu\n", (unsigned long long)entry->size );
+	fprintf( file, "used %llu\n", (unsigned long long)entry->lastUsed );
+
+	bool written = ferror( file ) == 0;
+
+	if ( fclose( file ) != 0 || !written )
+	{
+		remove( tempPath );
+		return false;
+	}
+
+	// Only Windows won't rename over a file, elsewhere the old metadata is replaced in the same step
+	#ifdef PLATFORM_WINDOWS
+		remove( entry->metaPath );
+	#endif
+
+	return rename( tempPath, entry->metaPath ) == 0;
+}
+
+static u64 archive_cache_file_size( const char *path )
+{
+	FILE *file = fopen( path, "rb" );
+	if ( !file )
+		return UINT64_MAX;
+
+	fseek( file, 0, SEEK_END );
+	u64 size = ftell( file );
+	fclose( file );
+
+	return size;
+}
+
+bool archive_cache_lookup( const char *cacheFolder, const char *url, const char *ext, ArchiveCacheEntry *entry )
+{
+	*entry = {};
+
+	string_utf8_format( entry->key, "%016llx", (unsigned long long)archive_cache_hash( url ) );
+
+	archive_cache_path( entry->archivePath, cacheFolder, entry->key, ext );
+	archive_cache_path( entry->metaPath, cacheFolder, entry->key, ".meta" );
+	archive_cache_path( entry->partPath, cacheFolder, entry->key, ".part" );
+
+	char folder[ ARCHIVE_CACHE_MAX_PATH ];
+	string_utf8_format( folder, "%s%s", cacheFolder, ARCHIVE_CACHE_FOLDER );
+
+	if ( !make_directory( folder ) )
+		return false;
+
+	bool found = archive_cache_read_meta( entry->metaPath, entry );
+
+	// A different url with the same hash, or an archive that went missing, is a miss
+	if ( found && ( !string_utf8_compare( entry->url, url ) || archive_cache_file_size( entry->archivePath ) != entry->size ) )
+		found = false;
+
+	if ( !found )
+	{
+		entry->validators = {};
+		entry->size = 0;
+	}
+
+	string_utf8_copy( entry->url, url );
+
+	return found && ( entry->validators.etag[ 0 ] || entry->validators.lastModified[ 0 ] );
+}
+
+[[nodiscard]] curl_slist *archive_cache_conditional_headers( const ArchiveCacheEntry *entry )
+{
+	curl_slist *headers = nullptr;
+	char header[ DOWNLOAD_MAX_VALIDATOR + 32 ];
+
+	if ( entry->validators.etag[ 0 ] )
+	{
+		string_utf8_format( header, "If-None-Match: %s", entry->validators.etag );
+		headers = curl_slist_append( headers, header );
+	}
+
+	if ( entry->validators.lastModified[ 0 ] )
+	{
+		string_utf8_format( header, "If-Modified-Since: %s", entry->validators.lastModified );
+		headers = curl_slist_append( headers, header );
+	}
+
+	return headers;
+}
+
+static bool archive_cache_finish( ArchiveCacheEntry *entry, const DownloadValidators *validators )
+{
+	entry->size = archive_cache_file_size( entry->archivePath );
+	entry->validators = *validators;
+	entry->lastUsed = static_cast<u64>( time( nullptr ) );
+
+	if ( entry->size == UINT64_MAX || !archive_cache_write_meta( entry ) )
+	{
+		remove( entry->archivePath );
+		remove( entry->metaPath );
+		return false;
+	}
+
+	return true;
+}
+
+bool archive_cache_store_file( ArchiveCacheEntry *entry, const char *path, const DownloadValidators *validators )
+{
+	#ifdef PLATFORM_WINDOWS
+		remove( entry->archivePath );
+	#endif
+
+	if ( rename( path, entry->archivePath ) != 0 )
+	{
+		// Different volumes, copy it over
+		if ( !copy_file( path, entry->archivePath ) )
+			return false;
+
+		remove( path );
+	}
+
+	return archive_cache_finish( entry, validators );
+}
+
+bool archive_cache_store_memory( ArchiveCacheEntry *entry, const u8 *data, u64 size, const DownloadValidators *validators )
+{
+	FILE *file = fopen( entry->partPath, "wb" );
+	if ( !file )
+		return false;
+
+	bool written = fwrite( data, 1, size, file ) == size;
+
+	if ( fclose( file ) != 0 || !written )
+	{
+		remove( entry->partPath );
+		return false;
+	}
+
+	return archive_cache_store_file( entry, entry->partPath, validators );
+}
+
+bool archive_cache_touch( ArchiveCacheEntry *entry )
+{
+	entry->lastUsed = static_cast<u64>( time( nullptr ) );
+
+	return archive_cache_write_meta( entry );
+}
+
+void archive_cache_remove( const ArchiveCacheEntry *entry )
+{
+	// The metadata first, an archive without it is never found
+	remove( entry->metaPath );
+	remove( entry->archivePath );
+}
+
+void archive_cache_evict( const char *cacheFolder, u64 maxBytes, const char *keepKey )
+{
+	char folder[ ARCHIVE_CACHE_MAX_PATH ];
+	string_utf8_format( folder, "%s%s", cacheFolder, ARCHIVE_CACHE_FOLDER );
+
+	// A handful of templates are cached, rescanning after each removal keeps this simple
+	for ( ;; )
+	{
+		DIR *dir = opendir( folder );
+		if ( !dir )
+			return;
+
+		u64 total = 0;
+		u64 oldestUsed = UINT64_MAX;
+		char oldestKey[ 17 ] = "";
+		struct dirent *ent;
+
+		while ( ( ent = readdir( dir ) ) != NULL )
+		{
+			const char *name = ent->d_name;
+			u64 length = string_utf8_bytes( name ) - 1;
+
+			if ( length != 16 + 5 || !string_utf8_compare( name + 16, ".meta" ) )
+				continue;
+
+			char metaPath[ ARCHIVE_CACHE_MAX_PATH ];
+			string_utf8_format( metaPath, "%s%s", folder, name );
+
+			ArchiveCacheEntry entry = {};
+			if ( !archive_cache_read_meta( metaPath, &entry ) )
+				continue;
+
+			total += entry.size;
+
+			if ( strncmp( name, keepKey, 16 ) != 0 && entry.lastUsed < oldestUsed )
+			{
+				oldestUsed = entry.lastUsed;
+				string_utf8_copy( oldestKey, name, 16 );
+			}
+		}
+
+		closedir( dir );
+
+		if ( total <= maxBytes || oldestKey[ 0 ] == '\0' )
+			return;
+
+		char path[ ARCHIVE_CACHE_MAX_PATH ];
+
+		log( "Evicting cached archive %s.", oldestKey );
+
+		// The metadata first, so an archive left behind is never found
+		archive_cache_path( path, cacheFolder, oldestKey, ".meta" );
+		remove( path );
+
+		// Whatever format the archive is in
+		dir = opendir( folder );
+		if ( !dir )
+			return;
+
+		while ( ( ent = readdir( dir ) ) != NULL )
+		{
+			if ( strncmp( ent->d_name, oldestKey, 16 ) == 0 && ent->d_name[ 16 ] == '.' )
+			{
+				string_utf8_format( path, "%s%s", folder, ent->d_name );
+				remove( path );
+			}
+		}
+
+		closedir( dir );
+	}
+}
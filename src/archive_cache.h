@@ -0,0 +1,40 @@
+#pragma once
+
+#define ARCHIVE_CACHE_MAX_PATH		( 4096 )
+#define ARCHIVE_CACHE_FOLDER		"archives/"
+
+// A downloaded archive kept on disk, with what is needed to ask the server if it changed.
+// Stored as <cache>/archives/<key><ext>, <ext> being its format's, next to a <key>.meta text file.
+struct ArchiveCacheEntry
+{
+	char key[ 17 ];
+	char url[ ARCHIVE_CACHE_MAX_PATH ];
+	char archivePath[ ARCHIVE_CACHE_MAX_PATH ];
+	char metaPath[ ARCHIVE_CACHE_MAX_PATH ];
+	char partPath[ ARCHIVE_CACHE_MAX_PATH ];
+	DownloadValidators validators;
+	u64 size;
+	u64 lastUsed;
+};
+
+// Fills in the entry for a url, always setting the paths, the archive's ending in ext
+// @return true if a usable archive is cached for it
+bool archive_cache_lookup( const char *cacheFolder, const char *url, const char *ext, ArchiveCacheEntry *entry );
+
+// If-None-Match / If-Modified-Since headers for revalidating the entry, free with curl_slist_free_all
+[[nodiscard]] curl_slist *archive_cache_conditional_headers( const ArchiveCacheEntry *entry );
+
+// Moves a downloaded archive file into the cache, copying it if it can't be moved
+bool archive_cache_store_file( ArchiveCacheEntry *entry, const char *path, const DownloadValidators *validators );
+
+// Writes an archive downloaded into memory to the cache
+bool archive_cache_store_memory( ArchiveCacheEntry *entry, const u8 *data, u64 size, const DownloadValidators *validators );
+
+// Marks the entry as just used, for eviction
+bool archive_cache_touch( ArchiveCacheEntry *entry );
+
+// Drops the entry, the archive is downloaded again next time
+void archive_cache_remove( const ArchiveCacheEntry *entry );
+
+// Removes the least recently used archives until the cache is no bigger than maxBytes, never the keep entry
+void archive_cache_evict( const char *cacheFolder, u64 maxBytes, const char *keepKey );
@@ -0,0 +1,79 @@
+#pragma once
+
+#define BUFFER_MIN_CAPACITY		( KB( 64 ) )
+
+// A growable byte buffer backed by an arena allocator.
+// If it is the last allocation in a bump allocator it grows in place without copying.
+struct Buffer
+{
+	Allocator *allocator = nullptr;
+	u8 *data = nullptr;
+	u64 size = 0;
+	u64 capacity = 0;
+
+	bool reserve( u64 bytes )
+	{
+		assert( allocator );
+
+		if ( bytes <= capacity )
+			return true;
+
+		u64 newCapacity = max( max( capacity * 2, bytes ), BUFFER_MIN_CAPACITY );
+		u8 *newData = grow( newCapacity );
+
+		// Doubling may not fit, try for exactly what is required
+		if ( !newData && newCapacity != bytes )
+		{
+			newCapacity = bytes;
+			newData = grow( newCapacity );
+		}
+
+		if ( !newData )
+			return false;
+
+		data = newData;
+		capacity = newCapacity;
+
+		return true;
+	}
+
+	bool append( const void *src, u64 bytes )
+	{
+		if ( !reserve( size + bytes ) )
+			return false;
+
+		memcpy( data + size, src, bytes );
+		size += bytes;
+
+		return true;
+	}
+
+	inline void clear()
+	{
+		size = 0;
+	}
+
+	void free()
+	{
+		if ( data )
+			allocator->free( data );
+
+		data = nullptr;
+		size = 0;
+		capacity = 0;
+	}
+
+	u8 *grow( u64 newCapacity )
+	{
+		// Last allocation, extend it in place
+		if ( data && allocator->lastAlloc == data )
+			return allocator->reallocate<u8>( data, newCapacity );
+
+		u8 *newData = allocator->allocate<u8>( newCapacity );
+
+		if ( newData && data )
+			memcpy( newData, data, size );
+
+		return newData;
+	}
+};
@@ -0,0 +1,179 @@
+// DIRECTORY CACHE //////////////////////////////////////////////////////////////////////
+u64 directory_cache_hash( const char *path, u64 bytes )
+{
+	u64 hash = 0xcbf29ce484222325ull;
+
+	for ( u64 i = 0; i < bytes; ++i )
+	{
+		hash ^= (u8)path[ i ];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+// The slot holding the path, or the empty slot it would go in
+static DirectoryCacheEntry *directory_cache_slot( const DirectoryCache *cache, const char *path, u64 bytes, u64 hash )
+{
+	u64 mask = cache->capacity - 1;
+
+	for ( u64 i = hash & mask; ; i = ( i + 1 ) & mask )
+	{
+		DirectoryCacheEntry *entry = &cache->entries[ i ];
+
+		if ( !entry->path || ( entry->hash == hash && entry->pathBytes == bytes && memcmp( entry->path, path, bytes ) == 0 ) )
+			return entry;
+	}
+}
+
+bool directory_cache_begin( DirectoryCache *cache, Allocator *allocator, const char *root, u64 maxFolders )
+{
+	*cache = {};
+	cache->allocator = allocator;
+	cache->root = root;
+	cache->rootEntry = { .hash = 0, .path = "", .pathBytes = 0, .skip = 0, .fd = -1, .ownsFd = false };
+
+	if ( !make_directory( root ) )
+		return false;
+
+	// Kept at most half full so a lookup finds an empty slot quickly. Smaller when the memory isn't there, with none every folder is uncached.
+	u64 capacity = 64;
+
+	while ( capacity < min<u64>( maxFolders, DIRECTORY_CACHE_MAX_FOLDERS ) * 2 )
+		capacity *= 2;
+
+	for ( ; capacity >= 64 && !cache->entries; capacity /= 2 )
+	{
+		cache->entries = allocator->allocate<DirectoryCacheEntry>( capacity, true );
+		cache->capacity = cache->entries ? capacity : 0;
+	}
+
+	#ifndef PLATFORM_WINDOWS
+		cache->rootEntry.fd = open( root, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+		cache->rootEntry.ownsFd = cache->rootEntry.fd >= 0;
+
+		if ( cache->rootEntry.fd < 0 )
+		{
+			directory_cache_end( cache );
+			return false;
+		}
+	#endif
+
+	return true;
+}
+
+void directory_cache_end( DirectoryCache *cache )
+{
+	#ifndef PLATFORM_WINDOWS
+		for ( u64 i = 0; i < cache->capacity && cache->openFds > 0; ++i )
+		{
+			if ( cache->entries[ i ].ownsFd )
+			{
+				close( cache->entries[ i ].fd );
+				cache->openFds -= 1;
+			}
+		}
+
+		if ( cache->rootEntry.ownsFd )
+			close( cache->rootEntry.fd );
+	#endif
+
+	// The name blocks follow the entries, they are all given back at once
+	if ( cache->names )
+	{
+		cache->allocator->attach( cache->names, cache->entries );
+		cache->allocator->free( cache->names );
+	}
+	else if ( cache->entries )
+	{
+		cache->allocator->free( cache->entries );
+	}
+
+	*cache = {};
+}
+
+const DirectoryCacheEntry *directory_cache_find( const DirectoryCache *cache, const char *path, u64 bytes )
+{
+	if ( bytes == 0 )
+		return &cache->rootEntry;
+
+	if ( cache->capacity == 0 )
+		return nullptr;
+
+	DirectoryCacheEntry *entry = directory_cache_slot( cache, path, bytes, directory_cache_hash( path, bytes ) );
+
+	return entry->path ? entry : nullptr;
+}
+
+const DirectoryCacheEntry *directory_cache_make( DirectoryCache *cache, const char *path, u64 bytes )
+{
+	const DirectoryCacheEntry *found = directory_cache_find( cache, path, bytes );
+	if ( found )
+		return found;
+
+	if ( ( cache->count + 1 ) * 2 > cache->capacity )
+		return nullptr;
+
+	// The parent first, it is found straight away for every folder after the first in it
+	u64 parentBytes = bytes;
+
+	while ( parentBytes > 0 && path[ parentBytes - 1 ] != '/' )
+		--parentBytes;
+
+	const DirectoryCacheEntry *parent = directory_cache_make( cache, path, parentBytes > 0 ? parentBytes - 1 : 0 );
+	if ( !parent )
+		return nullptr;
+
+	if ( bytes + 1 > cache->namesSize - cache->namesUsed )
+	{
+		u64 size = max<u64>( DIRECTORY_CACHE_NAMES_SIZE, bytes + 1 );
+
+		char *names = cache->allocator->allocate<char>( size );
+		if ( !names )
+			return nullptr;
+
+		cache->names = names;
+		cache->namesUsed = 0;
+		cache->namesSize = size;
+	}
+
+	char *copy = cache->names + cache->namesUsed;
+	string_utf8_copy( copy, cache->namesSize - cache->namesUsed, path, bytes );
+	cache->namesUsed += bytes + 1;
+
+	DirectoryCacheEntry made = { .hash = directory_cache_hash( path, bytes ), .path = copy, .pathBytes = static_cast<u32>( bytes ), .skip = parent->skip, .fd = parent->fd, .ownsFd = false };
+
+	#ifdef PLATFORM_WINDOWS
+		char fullPath[ MAX_FILEPATH ];
+		string_utf8_format( fullPath, sizeof( fullPath ), "%s%s", cache->root, copy );
+
+		if ( _mkdir( fullPath ) != 0 && errno != EEXIST )
+			return nullptr;
+	#else
+		// Only the part below the nearest open parent is resolved again
+		const char *relative = copy + parent->skip;
+
+		if ( mkdirat( parent->fd, relative, 0777 ) != 0 && errno != EEXIST )
+			return nullptr;
+
+		// Folders past the limit are reached from their nearest open parent
+		if ( cache->openFds < DIRECTORY_CACHE_MAX_FDS )
+		{
+			i32 fd = openat( parent->fd, relative, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+			if ( fd >= 0 )
+			{
+				made.fd = fd;
+				made.skip = static_cast<u32>( bytes + 1 );
+				made.ownsFd = true;
+				cache->openFds += 1;
+			}
+		}
+	#endif
+
+	DirectoryCacheEntry *entry = directory_cache_slot( cache, path, bytes, made.hash );
+	*entry = made;
+	cache->count += 1;
+
+	return entry;
+}
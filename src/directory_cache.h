@@ -0,0 +1,55 @@
+#pragma once
+
+#define DIRECTORY_CACHE_MAX_FDS			( 128 )
+#define DIRECTORY_CACHE_MAX_FOLDERS		( 8192 )
+#define DIRECTORY_CACHE_NAMES_SIZE		( KB( 16 ) )
+
+// A folder made under the root, found again without touching the filesystem.
+// Anything inside it is reached from fd with the path after its first skip bytes,
+// the folder's own fd when it has one, otherwise the nearest parent's.
+struct DirectoryCacheEntry
+{
+	u64 hash;
+	const char *path;
+	u32 pathBytes;
+	u32 skip;
+	i32 fd;
+	bool ownsFd;
+};
+
+// The folders made while extracting one archive, paths are relative to the root and have no trailing separator.
+// Each folder is created once, relative to its parent, instead of making every prefix of every path again.
+// Only the thread making folders changes it, lookups are safe from any thread once they are all made.
+struct DirectoryCache
+{
+	Allocator *allocator;
+	const char *root;
+	DirectoryCacheEntry rootEntry;
+
+	// Open addressing, capacity is a power of two
+	DirectoryCacheEntry *entries;
+	u64 capacity;
+	u64 count;
+	u64 openFds;
+
+	// Paths are packed into blocks, freed together with the entries
+	char *names;
+	u64 namesUsed;
+	u64 namesSize;
+};
+
+// FNV-1a of a path, also used for sets of file paths kept alongside the cache
+[[nodiscard]] u64 directory_cache_hash( const char *path, u64 bytes );
+
+// Makes the root folder and opens it, room is made for up to maxFolders folders when the memory is there.
+// Folders past the room are not cached, the caller makes them by their path.
+// @return false only if the root could not be made or opened
+bool directory_cache_begin( DirectoryCache *cache, Allocator *allocator, const char *root, u64 maxFolders );
+void directory_cache_end( DirectoryCache *cache );
+
+// Makes a folder, and any parents missing, unless it has been made already
+// @return nullptr if it could not be made or there is no room left
+const DirectoryCacheEntry *directory_cache_make( DirectoryCache *cache, const char *path, u64 bytes );
+
+// @return nullptr if the folder has not been made
+const DirectoryCacheEntry *directory_cache_find( const DirectoryCache *cache, const char *path, u64 bytes );
@@ -0,0 +1,552 @@
+// DOWNLOAD /////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] DOWNLOAD_ERROR_CLASS download_classify( CURLcode result, long responseCode )
+{
+	switch ( result )
+	{
+	case CURLE_OK:
+		return DOWNLOAD_ERROR_NONE;
+
+	case CURLE_HTTP_RETURNED_ERROR:
+		// Timeouts, rate limiting, server errors and a resume past the end can pass, anything else is the request itself
+		if ( responseCode == 408 || responseCode == 416 || responseCode == 425 || responseCode == 429 || responseCode >= 500 )
+			return DOWNLOAD_ERROR_RETRYABLE;
+		return DOWNLOAD_ERROR_FATAL;
+
+	case CURLE_UNSUPPORTED_PROTOCOL:
+	case CURLE_URL_MALFORMAT:
+	case CURLE_NOT_BUILT_IN:
+	case CURLE_FAILED_INIT:
+	case CURLE_OUT_OF_MEMORY:
+	case CURLE_WRITE_ERROR:
+	case CURLE_ABORTED_BY_CALLBACK:
+	case CURLE_TOO_MANY_REDIRECTS:
+	case CURLE_REMOTE_ACCESS_DENIED:
+	case CURLE_LOGIN_DENIED:
+	case CURLE_PEER_FAILED_VERIFICATION:
+	case CURLE_SSL_CERTPROBLEM:
+	case CURLE_SSL_CACERT_BADFILE:
+	case CURLE_SSL_ENGINE_NOTFOUND:
+	case CURLE_FILESIZE_EXCEEDED:
+		return DOWNLOAD_ERROR_FATAL;
+
+	// Name lookups, refused/reset connections, timeouts, low speed aborts, short transfers and unusable ranges
+	default:
+		return DOWNLOAD_ERROR_RETRYABLE;
+	}
+}
+
+static u64 download_random()
+{
+	static u64 state = 0;
+
+	// Seeded per process, so runners started together still spread out
+	if ( state == 0 )
+		state = ( time_now_ms() * 0x9E3779B97F4A7C15ull ) ^ (u64)(uintptr_t)&state ^ (u64)clock() ^ 0x2545F4914F6CDD1Dull;
+
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+
+	return state * 0x2545F4914F6CDD1Dull;
+}
+
+[[nodiscard]] u64 download_backoff_delay( const RetryPolicy *policy, i32 attempt, u64 retryAfterMs )
+{
+	u64 ceiling = policy->maxDelayMs;
+
+	if ( attempt < 32 && ( policy->baseDelayMs << attempt ) < ceiling )
+		ceiling = policy->baseDelayMs << attempt;
+
+	// Half fixed, half random, never immediate but still spread out
+	u64 delay = ceiling / 2 + download_random() % ( ceiling - ceiling / 2 + 1 );
+
+	// Honour the server asking for longer, up to the policy's maximum
+	if ( retryAfterMs > delay )
+		delay = min( retryAfterMs, policy->maxDelayMs );
+
+	return delay;
+}
+
+void download_collect_timings( CURL *handle, DownloadTimings *timings )
+{
+	curl_off_t nameLookup = 0, connect = 0, appConnect = 0, firstByte = 0, total = 0, bytes = 0, speed = 0;
+	long redirects = 0;
+
+	curl_easy_getinfo( handle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup );
+	curl_easy_getinfo( handle, CURLINFO_CONNECT_TIME_T, &connect );
+	curl_easy_getinfo( handle, CURLINFO_APPCONNECT_TIME_T, &appConnect );
+	curl_easy_getinfo( handle, CURLINFO_STARTTRANSFER_TIME_T, &firstByte );
+	curl_easy_getinfo( handle, CURLINFO_TOTAL_TIME_T, &total );
+	curl_easy_getinfo( handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes );
+	curl_easy_getinfo( handle, CURLINFO_SPEED_DOWNLOAD_T, &speed );
+	curl_easy_getinfo( handle, CURLINFO_REDIRECT_COUNT, &redirects );
+
+	timings->nameLookupUs = static_cast<u64>( nameLookup );
+	timings->connectUs = static_cast<u64>( connect );
+	timings->appConnectUs = static_cast<u64>( appConnect );
+	timings->firstByteUs = static_cast<u64>( firstByte );
+	timings->totalUs = static_cast<u64>( total );
+	timings->bytes = static_cast<u64>( bytes );
+	timings->bytesPerSecond = static_cast<u64>( speed );
+	timings->redirects = static_cast<u64>( redirects );
+}
+
+void download_progress_sample( DownloadProgress *progress, u64 bytes )
+{
+	u64 now = time_now_ms();
+
+	if ( progress->startMs == 0 )
+	{
+		progress->startMs = now;
+		progress->lastMs = now;
+		progress->intervalMs = DOWNLOAD_SAMPLE_INTERVAL;
+	}
+
+	// A new attempt starts counting again
+	if ( bytes < progress->lastBytes )
+		progress->lastBytes = 0;
+
+	u64 elapsed = now - progress->lastMs;
+
+	if ( elapsed < progress->intervalMs )
+		return;
+
+	if ( progress->sampleCount == DOWNLOAD_MAX_SAMPLES )
+	{
+		for ( u64 i = 0; i < DOWNLOAD_MAX_SAMPLES / 2; ++i )
+			progress->samples[ i ] = progress->samples[ i * 2 + 1 ];
+
+		progress->sampleCount = DOWNLOAD_MAX_SAMPLES / 2;
+		progress->intervalMs *= 2;
+	}
+
+	u64 bytesPerSecond = ( bytes - progress->lastBytes ) * 1000 / elapsed;
+
+	progress->samples[ progress->sampleCount++ ] = { .ms = now - progress->startMs, .bytesPerSecond = bytesPerSecond };
+	progress->peakBytesPerSecond = max( progress->peakBytesPerSecond, bytesPerSecond );
+	progress->lastMs = now;
+	progress->lastBytes = bytes;
+}
+
+i32 download_progress_callback( void *userdata, curl_off_t, curl_off_t downloadNow, curl_off_t, curl_off_t )
+{
+	download_progress_sample( (DownloadProgress *)userdata, static_cast<u64>( downloadNow ) );
+	return 0;
+}
+
+static CURLSH *downloadShare = nullptr;
+
+void download_share_init()
+{
+	downloadShare = curl_share_init();
+	if ( !downloadShare )
+		return;
+
+	curl_share_setopt( downloadShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+	curl_share_setopt( downloadShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+	curl_share_setopt( downloadShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT );
+}
+
+void download_share_cleanup()
+{
+	curl_share_cleanup( downloadShare );
+	downloadShare = nullptr;
+}
+
+void download_apply_policy( CURL *handle, const RetryPolicy *policy )
+{
+	if ( downloadShare )
+		curl_easy_setopt( handle, CURLOPT_SHARE, downloadShare );
+
+	curl_easy_setopt( handle, CURLOPT_FAILONERROR, 1 );
+	curl_easy_setopt( handle, CURLOPT_TIMEOUT_MS, (long)policy->attemptTimeoutMs );
+	curl_easy_setopt( handle, CURLOPT_LOW_SPEED_LIMIT, (long)policy->lowSpeedLimit );
+	curl_easy_setopt( handle, CURLOPT_LOW_SPEED_TIME, (long)policy->lowSpeedTime );
+}
+
+// Case insensitive match of a header name, returns the trimmed value or nullptr
+static const char *download_header_value( char *data, u64 bytes, const char *name )
+{
+	u64 length = string_utf8_bytes( name ) - 1;
+
+	if ( bytes <= length )
+		return nullptr;
+
+	for ( u64 i = 0; i < length; ++i )
+	{
+		if ( ascii_char_lower( data[ i ] ) != name[ i ] )
+			return nullptr;
+	}
+
+	char *value = data + length;
+	char *end = data + bytes;
+
+	while ( value < end && ( *value == ' ' || *value == '\t' ) )
+		++value;
+
+	while ( end > value && ( end[ -1 ] == '\r' || end[ -1 ] == '\n' || end[ -1 ] == ' ' ) )
+		--end;
+
+	*end = '\0';
+
+	return value;
+}
+
+u64 download_validators_header( char *data, u64 size, u64 nmemb, void *userdata )
+{
+	DownloadValidators *validators = (DownloadValidators *)userdata;
+	u64 bytes = size * nmemb;
+
+	// Each response of a redirect chain starts with its status line, only the last one counts
+	if ( bytes >= 5 && strncmp( data, "HTTP/", 5 ) == 0 )
+	{
+		validators->etag[ 0 ] = '\0';
+		validators->lastModified[ 0 ] = '\0';
+		return bytes;
+	}
+
+	// Copied so the value can be terminated without touching curl's buffer
+	char line[ DOWNLOAD_MAX_VALIDATOR + 32 ];
+	if ( bytes >= sizeof( line ) )
+		return bytes;
+
+	memcpy( line, data, bytes );
+
+	const char *value;
+
+	if ( ( value = download_header_value( line, bytes, "etag:" ) ) )
+		string_utf8_copy( validators->etag, value );
+	else if ( ( value = download_header_value( line, bytes, "last-modified:" ) ) )
+		string_utf8_copy( validators->lastModified, value );
+
+	return bytes;
+}
+
+curl_slist *download_if_range( const DownloadValidators *validators )
+{
+	char header[ DOWNLOAD_MAX_VALIDATOR + 16 ];
+
+	if ( validators->etag[ 0 ] && strncmp( validators->etag, "W/", 2 ) != 0 )
+		string_utf8_format( header, "If-Range: %s", validators->etag );
+	else if ( validators->lastModified[ 0 ] )
+		string_utf8_format( header, "If-Range: %s", validators->lastModified );
+	else
+		return nullptr;
+
+	return curl_slist_append( nullptr, header );
+}
+
+struct DownloadProbe
+{
+	bool acceptRanges;
+	DownloadValidators *validators;
+};
+
+static u64 download_probe_header( char *data, u64 size, u64 nmemb, void *userdata )
+{
+	DownloadProbe *probe = (DownloadProbe *)userdata;
+	u64 bytes = size * nmemb;
+	const char *acceptRanges = "accept-ranges: bytes";
+	u64 length = string_utf8_bytes( acceptRanges ) - 1;
+
+	if ( bytes >= length )
+	{
+		bool match = true;
+
+		for ( u64 i = 0; i < length && match; ++i )
+			match = ascii_char_lower( data[ i ] ) == acceptRanges[ i ];
+
+		if ( match )
+			probe->acceptRanges = true;
+	}
+
+	return download_validators_header( data, size, nmemb, probe->validators );
+}
+
+u64 download_probe_ranges( const char *url, char *effectiveUrl, u64 maxEffectiveUrl, const RetryPolicy *policy, curl_slist *headers, DownloadValidators *validators, long *responseCode )
+{
+	*responseCode = 0;
+
+	CURL *handle = curl_easy_init();
+	if ( !handle )
+		return 0;
+
+	DownloadProbe probe = { .acceptRanges = false, .validators = validators };
+
+	download_apply_policy( handle, policy );
+	curl_easy_setopt( handle, CURLOPT_URL, url );
+	curl_easy_setopt( handle, CURLOPT_NOBODY, 1 );
+	curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, 1 );
+	curl_easy_setopt( handle, CURLOPT_HTTPHEADER, headers );
+	curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, download_probe_header );
+	curl_easy_setopt( handle, CURLOPT_HEADERDATA, &probe );
+
+	CURLcode res = curl_easy_perform( handle );
+
+	curl_off_t contentLength = -1;
+	const char *finalUrl = nullptr;
+
+	if ( res == CURLE_OK )
+	{
+		curl_easy_getinfo( handle, CURLINFO_RESPONSE_CODE, responseCode );
+		curl_easy_getinfo( handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength );
+		curl_easy_getinfo( handle, CURLINFO_EFFECTIVE_URL, &finalUrl );
+	}
+
+	u64 result = 0;
+
+	if ( *responseCode == 200 && probe.acceptRanges && contentLength > 0 && finalUrl )
+	{
+		string_utf8_copy( effectiveUrl, maxEffectiveUrl, finalUrl );
+		result = static_cast<u64>( contentLength );
+	}
+
+	curl_easy_cleanup( handle );
+
+	return result;
+}
+
+static u64 download_range_write( void *data, u64 size, u64 nmemb, void *userdata )
+{
+	DownloadRange *range = (DownloadRange *)userdata;
+	u64 bytes = size * nmemb;
+
+	// Only a range served as one is written, a server that ignores it sends the archive from the start
+	long responseCode = 0;
+	curl_easy_getinfo( range->handle, CURLINFO_RESPONSE_CODE, &responseCode );
+
+	if ( responseCode != 206 )
+		return 0;
+
+	// Server sent more than the range, stop before writing over other ranges
+	if ( range->start + range->received + bytes > range->end + 1 )
+		return 0;
+
+	if ( range->memory )
+	{
+		memcpy( range->memory + range->start + range->received, data, bytes );
+	}
+	else if ( fwrite( data, 1, bytes, range->file ) != bytes )
+	{
+		return 0;
+	}
+
+	range->received += bytes;
+
+	return bytes;
+}
+
+CURLcode download_ranged( const char *url, u64 contentLength, i32 connections, DownloadRanges *ranges, Buffer *buffer, const char *filePath, const RetryPolicy *policy,
+	const DownloadValidators *validators, long *responseCode, DownloadTimings *timings, DownloadProgress *progress, char *errorString )
+{
+	CURLcode res = CURLE_OK;
+	u64 startMs = time_now_ms();
+	u64 startReceived = 0;
+
+	errorString[ 0 ] = '\0';
+	*responseCode = 0;
+	*timings = {};
+
+	// First attempt, split the archive up and prepare where it goes
+	if ( ranges->count == 0 )
+	{
+		u64 rangeSize = max( ( contentLength + connections - 1 ) / connections, DOWNLOAD_MIN_RANGE_SIZE );
+
+		ranges->count = ( contentLength + rangeSize - 1 ) / rangeSize;
+
+		assert( ranges->count <= DOWNLOAD_MAX_CONNECTIONS );
+
+		for ( u64 i = 0; i < ranges->count; ++i )
+		{
+			DownloadRange *range = &ranges->ranges[ i ];
+			range->start = i * rangeSize;
+			range->end = min( range->start + rangeSize, contentLength ) - 1;
+			range->received = 0;
+		}
+
+		if ( buffer )
+		{
+			buffer->clear();
+
+			if ( !buffer->reserve( contentLength ) )
+			{
+				ranges->count = 0;
+				string_utf8_copy( errorString, CURL_ERROR_SIZE, "Archive does not fit in the reserved memory, increase -memory." );
+				return CURLE_OUT_OF_MEMORY;
+			}
+
+			buffer->size = contentLength;
+		}
+		else
+		{
+			// Create the file, each range then writes into its own part of it
+			FILE *file = fopen( filePath, "wb" );
+			if ( !file )
+			{
+				ranges->count = 0;
+				string_utf8_format( errorString, CURL_ERROR_SIZE, "Failed to open the file: %s.", filePath );
+				return CURLE_WRITE_ERROR;
+			}
+			fclose( file );
+		}
+	}
+
+	CURLM *multi = curl_multi_init();
+	if ( !multi )
+		return CURLE_FAILED_INIT;
+
+	// Only the version the ranges were sized from is wanted, one that changed since is refused by the write
+	curl_slist *ifRange = download_if_range( validators );
+
+	// Separate connections are wanted, don't multiplex onto one
+	curl_multi_setopt( multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING );
+
+	for ( u64 i = 0; i < ranges->count; ++i )
+	{
+		DownloadRange *range = &ranges->ranges[ i ];
+		u64 offset = range->start + range->received;
+
+		range->handle = nullptr;
+		range->file = nullptr;
+		range->memory = buffer ? buffer->data : nullptr;
+		range->errorString[ 0 ] = '\0';
+
+		// Completed on an earlier attempt
+		if ( offset > range->end )
+			continue;
+
+		if ( !buffer )
+		{
+			range->file = fopen( filePath, "r+b" );
+			if ( !range->file || fseek( range->file, static_cast<long>( offset ), SEEK_SET ) != 0 )
+			{
+				string_utf8_format( errorString, CURL_ERROR_SIZE, "Failed to open the file: %s.", filePath );
+				res = CURLE_WRITE_ERROR;
+				break;
+			}
+		}
+
+		range->handle = curl_easy_init();
+		if ( !range->handle )
+		{
+			res = CURLE_FAILED_INIT;
+			break;
+		}
+
+		if ( range->received )
+			log( "Resuming range %llu-%llu from %llu.", (unsigned long long)range->start, (unsigned long long)range->end, (unsigned long long)offset );
+
+		char rangeString[ 64 ];
+		string_utf8_format( rangeString, "%llu-%llu", (unsigned long long)offset, (unsigned long long)range->end );
+
+		download_apply_policy( range->handle, policy );
+		curl_easy_setopt( range->handle, CURLOPT_URL, url );
+		curl_easy_setopt( range->handle, CURLOPT_RANGE, rangeString );
+		curl_easy_setopt( range->handle, CURLOPT_HTTPHEADER, ifRange );
+		curl_easy_setopt( range->handle, CURLOPT_FOLLOWLOCATION, 1 );
+		curl_easy_setopt( range->handle, CURLOPT_WRITEFUNCTION, download_range_write );
+		curl_easy_setopt( range->handle, CURLOPT_WRITEDATA, range );
+		curl_easy_setopt( range->handle, CURLOPT_ERRORBUFFER, range->errorString );
+
+		curl_multi_add_handle( multi, range->handle );
+	}
+
+	for ( u64 i = 0; i < ranges->count; ++i )
+		startReceived += ranges->ranges[ i ].received;
+
+	i32 running = 0;
+
+	while ( res == CURLE_OK )
+	{
+		CURLMcode mc = curl_multi_perform( multi, &running );
+
+		u64 received = 0;
+		for ( u64 i = 0; i < ranges->count; ++i )
+			received += ranges->ranges[ i ].received;
+
+		download_progress_sample( progress, received - startReceived );
+
+		if ( mc == CURLM_OK && running )
+			mc = curl_multi_poll( multi, nullptr, 0, 1000, nullptr );
+
+		if ( mc != CURLM_OK )
+		{
+			string_utf8_copy( errorString, CURL_ERROR_SIZE, curl_multi_strerror( mc ) );
+			res = CURLE_RECV_ERROR;
+		}
+
+		if ( !running )
+			break;
+	}
+
+	// Every range needs to have completed, and been served as a range
+	CURLMsg *msg;
+	i32 messagesLeft;
+
+	while ( ( msg = curl_multi_info_read( multi, &messagesLeft ) ) )
+	{
+		if ( msg->msg == CURLMSG_DONE && msg->data.result != CURLE_OK && res == CURLE_OK )
+			res = msg->data.result;
+	}
+
+	for ( u64 i = 0; i < ranges->count; ++i )
+	{
+		DownloadRange *range = &ranges->ranges[ i ];
+
+		if ( range->handle )
+		{
+			long rangeResponseCode = 0;
+			curl_easy_getinfo( range->handle, CURLINFO_RESPONSE_CODE, &rangeResponseCode );
+
+			// The first error, otherwise what the ranges were served with
+			if ( *responseCode < 400 && rangeResponseCode != 0 )
+				*responseCode = rangeResponseCode;
+
+			DownloadTimings rangeTimings;
+			download_collect_timings( range->handle, &rangeTimings );
+
+			timings->nameLookupUs = max( timings->nameLookupUs, rangeTimings.nameLookupUs );
+			timings->connectUs = max( timings->connectUs, rangeTimings.connectUs );
+			timings->appConnectUs = max( timings->appConnectUs, rangeTimings.appConnectUs );
+			timings->firstByteUs = max( timings->firstByteUs, rangeTimings.firstByteUs );
+			timings->totalUs = max( timings->totalUs, rangeTimings.totalUs );
+			timings->redirects = max( timings->redirects, rangeTimings.redirects );
+			timings->bytes += rangeTimings.bytes;
+
+			// A server that ignores the range replies with the whole archive
+			bool served = ( rangeResponseCode == 0 || rangeResponseCode >= 400 || rangeResponseCode == 206 ) && ( res != CURLE_OK || range->received == range->end - range->start + 1 );
+
+			if ( !served && res != CURLE_RANGE_ERROR )
+			{
+				string_utf8_format( errorString, CURL_ERROR_SIZE, "Range %llu-%llu was not served ( HTTP %ld, %llu bytes ).",
+					(unsigned long long)range->start, (unsigned long long)range->end, rangeResponseCode, (unsigned long long)range->received );
+				res = CURLE_RANGE_ERROR;
+			}
+
+			// Nothing of it is trusted, the next attempt asks for the whole range again
+			if ( !served )
+				range->received = 0;
+
+			if ( res != CURLE_OK && errorString[ 0 ] == '\0' )
+				string_utf8_copy( errorString, CURL_ERROR_SIZE, range->errorString );
+
+			curl_multi_remove_handle( multi, range->handle );
+			curl_easy_cleanup( range->handle );
+			range->handle = nullptr;
+		}
+
+		if ( range->file )
+		{
+			fclose( range->file );
+			range->file = nullptr;
+		}
+	}
+
+	curl_multi_cleanup( multi );
+	curl_slist_free_all( ifRange );
+
+	u64 elapsedMs = time_now_ms() - startMs;
+	timings->bytesPerSecond = elapsedMs ? timings->bytes * 1000 / elapsedMs : timings->bytes;
+
+	return res;
+}
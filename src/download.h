@@ -0,0 +1,147 @@
+#pragma once
+
+#define DOWNLOAD_MIN_RANGE_SIZE		( MB( 1 ) )
+#define DOWNLOAD_MAX_CONNECTIONS	( 16 )
+#define DOWNLOAD_MAX_ATTEMPTS		( 64 )
+#define DOWNLOAD_MAX_VALIDATOR		( 256 )
+#define DOWNLOAD_MAX_SAMPLES		( 128 )
+#define DOWNLOAD_SAMPLE_INTERVAL	( 250 )
+
+enum DOWNLOAD_ERROR_CLASS
+{
+	DOWNLOAD_ERROR_NONE,
+	DOWNLOAD_ERROR_RETRYABLE,
+	DOWNLOAD_ERROR_FATAL,
+};
+
+// How failed attempts are retried, and when an attempt is given up on
+struct RetryPolicy
+{
+	u64 baseDelayMs = 500;
+	u64 maxDelayMs = 30000;
+	u64 attemptTimeoutMs = 0;	// 0 = no limit
+	u64 lowSpeedLimit = 0;		// bytes per second, 0 = off
+	u64 lowSpeedTime = 0;		// seconds below lowSpeedLimit before the attempt is aborted
+};
+
+// Where the time of a transfer went, times are microseconds from the start of the request
+// For a ranged download each time is the slowest range, and bytes are all the ranges together
+struct DownloadTimings
+{
+	u64 nameLookupUs;
+	u64 connectUs;
+	u64 appConnectUs;
+	u64 firstByteUs;
+	u64 totalUs;
+	u64 bytes;
+	u64 bytesPerSecond;
+	u64 redirects;
+};
+
+// The outcome of one download attempt
+struct DownloadAttempt
+{
+	CURLcode result;
+	long responseCode;
+	DOWNLOAD_ERROR_CLASS errorClass;
+	u64 durationMs;
+	u64 delayMs;
+	DownloadTimings timings;
+};
+
+// Throughput sampled while downloading, across every attempt
+struct DownloadSample
+{
+	u64 ms;
+	u64 bytesPerSecond;
+};
+
+struct DownloadProgress
+{
+	u64 startMs;
+	u64 lastMs;
+	u64 lastBytes;
+	u64 intervalMs;
+	u64 peakBytesPerSecond;
+	u64 sampleCount;
+	DownloadSample samples[ DOWNLOAD_MAX_SAMPLES ];
+};
+
+// The response headers that identify a version of the archive, sent back to revalidate it
+struct DownloadValidators
+{
+	char etag[ DOWNLOAD_MAX_VALIDATOR ];
+	char lastModified[ DOWNLOAD_MAX_VALIDATOR ];
+};
+
+// One byte range of a parallel download
+struct DownloadRange
+{
+	CURL *handle;
+	u64 start;
+	u64 end;
+	u64 received;
+	u8 *memory;
+	FILE *file;
+	char errorString[ CURL_ERROR_SIZE ];
+};
+
+// The ranges of a parallel download, kept between attempts so a retry only fetches what is missing
+struct DownloadRanges
+{
+	DownloadRange ranges[ DOWNLOAD_MAX_CONNECTIONS ];
+	u64 count;
+};
+
+// Whether a failed attempt is worth retrying, a missing repo or a bad url will fail the same way every time
+[[nodiscard]] DOWNLOAD_ERROR_CLASS download_classify( CURLcode result, long responseCode );
+
+// Exponential backoff with equal jitter, half the delay fixed and half random, so many clients failing together don't retry together
+// retryAfterMs is the server's Retry-After, used as the minimum when given, up to the policy's maximum
+[[nodiscard]] u64 download_backoff_delay( const RetryPolicy *policy, i32 attempt, u64 retryAfterMs );
+
+// Applies the per-attempt timeout and low speed abort to a handle, and makes http errors fail the transfer
+// After download_share_init the handle also shares connections, name lookups and TLS sessions with the others
+void download_apply_policy( CURL *handle, const RetryPolicy *policy );
+
+// Lets every handle reuse what the others connected, for downloading many archives in one run
+void download_share_init();
+void download_share_cleanup();
+
+// Reads the timings of a finished transfer
+void download_collect_timings( CURL *handle, DownloadTimings *timings );
+
+// Records the throughput since the last sample, bytes is the total received by the current attempt so far
+// When full, every other sample is dropped and the interval doubles, so a long download is still covered
+void download_progress_sample( DownloadProgress *progress, u64 bytes );
+
+// CURLOPT_XFERINFOFUNCTION that samples into the DownloadProgress given as CURLOPT_XFERINFODATA
+i32 download_progress_callback( void *userdata, curl_off_t downloadTotal, curl_off_t downloadNow, curl_off_t uploadTotal, curl_off_t uploadNow );
+
+// CURLOPT_HEADERFUNCTION that records the ETag and Last-Modified of the final response into DownloadValidators
+u64 download_validators_header( char *data, u64 size, u64 nmemb, void *userdata );
+
+// @return true if an If-Range header can name the version, which a weak ETag alone can't
+[[nodiscard]] inline bool download_validators_usable( const DownloadValidators *validators )
+{
+	return validators->lastModified[ 0 ] || ( validators->etag[ 0 ] && strncmp( validators->etag, "W/", 2 ) != 0 );
+}
+
+// An If-Range header for the version the validators name, so a resumed or ranged request that finds the archive changed gets all of it with 200
+// A weak ETag can't be used, Last-Modified is sent instead
+// @return nullptr when there is nothing to send, the caller frees the list
+[[nodiscard]] curl_slist *download_if_range( const DownloadValidators *validators );
+
+// Asks the server for the archive size and whether it accepts range requests
+// headers are sent with the request, responseCode is set to the final status ( 304 when a conditional request matched )
+// @return the content length, or 0 if the archive can't be fetched in ranges
+u64 download_probe_ranges( const char *url, char *effectiveUrl, u64 maxEffectiveUrl, const RetryPolicy *policy, curl_slist *headers, DownloadValidators *validators, long *responseCode );
+
+// Fetches the archive as byte ranges over several connections at once
+// Writes into buffer if given, otherwise into the file at filePath
+// Calling again with the same ranges resumes whatever did not complete
+// Every range is asked for with If-Range from validators, a range answered with 200 means the archive changed or ranges aren't served
+// responseCode is set to the http status of the first range that failed, otherwise to the status the ranges were served with.
+// timings and progress cover only this call.
+CURLcode download_ranged( const char *url, u64 contentLength, i32 connections, DownloadRanges *ranges, Buffer *buffer, const char *filePath, const RetryPolicy *policy,
+	const DownloadValidators *validators, long *responseCode, DownloadTimings *timings, DownloadProgress *progress, char *errorString );
@@ -2,19 +2,42 @@
 // System Includes
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <cmath>
 #include <cfloat>
 #include <cstdio>
 #include <assert.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // Platform Specific Includes
 #ifdef PLATFORM_WINDOWS
 #include <direct.h>
+#include <io.h>
+#include <fcntl.h>
 	#include "dirent/dirent.h"
 #else
 	#include <sys/stat.h>
 	#include <dirent.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <signal.h>
+#endif
+
+#ifdef PLATFORM_LINUX
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/fs.h>
+	#include <linux/io_uring.h>
+#endif
+
+#ifdef PLATFORM_MAC
+	#include <sys/clonefile.h>
 #endif
 
 // Third Party Includes
@@ -33,6 +56,17 @@
 #include "strings.h"
 #include "map.h"
 #include "utility.h"
+#include "buffer.h"
+#include "zip_stream.h"
+#include "tar_stream.h"
+#include "zip_map.h"
+#include "directory_cache.h"
+#include "tree_remove.h"
+#include "uring_writer.h"
+#include "download.h"
+#include "archive_cache.h"
+#include "tree_cache.h"
+#include "substitute.h"
 
 // --------------------------------------------------------------------------------
 
@@ -51,6 +85,9 @@ enum RESULT_CODE
 	RESULT_CODE_FAILED_TO_ALLOCATE_HEAP_MEMORY,
 	RESULT_CODE_FAILED_TO_OPEN_ARCHIVE,
 	RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE,
+	RESULT_CODE_FAILED_TO_PARSE_MANIFEST,
+	RESULT_CODE_FAILED_TO_MOVE_PROJECT,
+	RESULT_CODE_FAILED_TO_PARSE_VARIABLES,
 };
 
 static constexpr const char *RESULT_CODE_NAME[] = 
@@ -65,32 +102,199 @@ static constexpr const char *RESULT_CODE_NAME[] =
 	"RESULT_CODE_CURL_FAILED_INIT",
 	"RESULT_CODE_FAILED_TO_OPEN_FILE",
 	"RESULT_CODE_FAILED_TO_RETRIEVE_DATA",
+	"RESULT_CODE_FAILED_TO_ALLOCATE_HEAP_MEMORY",
 	"RESULT_CODE_FAILED_TO_OPEN_ARCHIVE",
 	"RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE",
+	"RESULT_CODE_FAILED_TO_PARSE_MANIFEST",
+	"RESULT_CODE_FAILED_TO_MOVE_PROJECT",
+	"RESULT_CODE_FAILED_TO_PARSE_VARIABLES",
 };
 
 constexpr const i64 MAX_COMMANDS = 32;
 constexpr const i64 MAX_FILEPATH = 4096;
-constexpr const char *TEMP_ARCHIVE_FILE = "file.zip";
+constexpr const char *TEMP_ARCHIVE_FILE = "file";
+constexpr const char *PROJECT_STAGING_SUFFIX = ".staging/";
+constexpr const char *PROJECT_TOMBSTONE_SUFFIX = ".tombstone.";
+constexpr const u64 PROJECT_TOMBSTONE_MAX_AGE_US = 3600ULL * 1000000;
+constexpr const char *PROJECT_RECORD_FILE = ".template-downloader";
+constexpr const char *PROJECT_SETUP_FILES[] = { "run.bat", "build.bat" };
+constexpr const u64 PROJECT_SETUP_FILE_COUNT = sizeof( PROJECT_SETUP_FILES ) / sizeof( PROJECT_SETUP_FILES[ 0 ] );
+constexpr const i64 MAX_VARIABLES = 32;
+static_assert( 1 + 2 * MAX_VARIABLES <= SUBSTITUTE_MAX_PATTERNS, "Every variable and the project name must fit in a Substitute" );
+constexpr const i64 MAX_THREADS = 64;
+constexpr const u64 EXTRACT_MIN_FILES_PER_THREAD = 8;
+constexpr const u64 EXTRACT_FILE_COST = KB( 16 );
+constexpr const u64 EXTRACT_BATCH_COST = KB( 256 );
+constexpr const u64 EXTRACT_BATCH_MAX_FILES = 64;
+constexpr const u64 EXTRACT_CHUNK_SIZE = KB( 256 );
+
+enum SOURCE_FORMAT
+{
+	SOURCE_FORMAT_ZIP,
+	SOURCE_FORMAT_TAR_GZ,
+};
+
+const char *SOURCE_FORMAT_EXTENSION[] =
+{
+	".zip",
+	".tar.gz",
+};
+
+// What reads the entries of a zip archive
+enum ZIP_READER
+{
+	ZIP_READER_LIBZIP,
+	ZIP_READER_MAP,
+};
+
+// What writes the extracted files
+enum IO_BACKEND
+{
+	IO_BACKEND_STDIO,
+	IO_BACKEND_URING,
+};
+
+// What is flushed to the disk before a project is renamed into place
+enum DURABILITY
+{
+	DURABILITY_NONE,
+	DURABILITY_FILE,
+	DURABILITY_BATCH,
+};
+
+enum STATS_FORMAT
+{
+	STATS_FORMAT_NONE,
+	STATS_FORMAT_JSON,
+};
 
 struct Options
 {
 	bool verbose = false;
+	bool inMemory = false;
+	bool stream = false;
+	bool incremental = false;
 	char destFolder[ MAX_FILEPATH ] = ".";
 	char projectName[ MAX_FILEPATH ] = "";
 	char sourceRepo[ MAX_FILEPATH ] = "";
-	char rootFolder[ MAX_FILEPATH ] = "";
-	char finalProjectFolder[ MAX_FILEPATH ] = "";
+	char manifest[ MAX_FILEPATH ] = "";
+	const char *variableArgs[ MAX_VARIABLES ];
+	u64 variableArgCount = 0;
+	char variablesFile[ MAX_FILEPATH ] = "";
+	SOURCE_FORMAT format = SOURCE_FORMAT_ZIP;
+	ZIP_READER zipReader = ZIP_READER_LIBZIP;
+	IO_BACKEND ioBackend = IO_BACKEND_STDIO;
+	DURABILITY durability = DURABILITY_NONE;
+	TREE_LINK treeLink = TREE_LINK_CLONE;
+	i32 threads = 4;
+	i32 extractThreads = 0;
+	STATS_FORMAT stats = STATS_FORMAT_NONE;
 	i32 attempts = 6;
+	i32 connections = 1;
+	RetryPolicy retry;
+	char cacheFolder[ MAX_FILEPATH ] = "";
+	u64 cacheSize = MB( 1024 );
 	u64 permanentSize = 0;
 	u64 transientSize = MB( 4 );
 	u64 fastBumpSize = 0;
 
 } options;
 
+// A find / replace pair applied to a project's files
+struct Variable
+{
+	const char *find;
+	const char *replace;
+};
+
+// An archive, downloaded once for every project made from it
+struct Source
+{
+	char url[ MAX_FILEPATH ];
+	char archivePath[ MAX_FILEPATH ];
+	SOURCE_FORMAT format;
+	Buffer archive;
+	ArchiveCacheEntry cached;
+	DownloadValidators validators;
+	char commitId[ TREE_CACHE_MAX_ID ];
+	Array<DownloadAttempt, DOWNLOAD_MAX_ATTEMPTS + 1> attempts;
+	DownloadProgress progress;
+	bool cacheHit;
+	bool streamed;
+	RESULT_CODE result;
+};
+
+// How the extraction of a project's archive was scheduled, and how long it took
+struct ExtractStats
+{
+	u64 files;
+	u64 tasks;
+	u64 threads;
+	u64 wallUs;
+	u64 workUs;
+	u64 criticalPathUs;
+	u64 busiestThreadUs;
+
+	// Updating a project in place, files already the same and those the archive no longer has
+	u64 unchanged;
+	u64 removed;
+};
+
+// A setup file as the archive has it, before its placeholders are replaced, and as it was written after.
+// Kept beside the project, so updating it in place leaves the setup files alone when neither has changed.
+struct SetupFileRecord
+{
+	bool known;
+	bool kept;
+	u32 archiveCrc;
+	u64 archiveSize;
+	u32 writtenCrc;
+	u64 writtenSize;
+};
+
+struct Project
+{
+	char name[ MAX_FILEPATH ];
+	char destFolder[ MAX_FILEPATH ];
+	char stagingFolder[ MAX_FILEPATH ];
+	char finalProjectFolder[ MAX_FILEPATH ];
+	char tombstoneFolder[ MAX_FILEPATH ];
+	Source *source;
+	Variable variables[ MAX_VARIABLES ];
+	u64 variableCount;
+	u64 group;
+	bool storeTree;
+	bool scanFolder;
+	ExtractStats extractStats;
+	u64 syncUs;
+	RESULT_CODE result;
+};
+
 struct App
 {
 	MemoryArena memoryArena;
+	Project *projects;
+	u64 projectCount;
+	u64 maxProjects;
+	Source *sources;
+	u64 sourceCount;
+	u64 extractThreads;
+
+	// Pairs replaced in every project, from -var and -vars, before a project's own from the manifest
+	Variable variables[ MAX_VARIABLES ];
+	u64 variableCount;
+
+	// The projects replaced, in the order their old folders were renamed to tombstones, each the project's index.
+	// Guarded by tombstoneMutex, tombstoneQueued wakes the thread removing them when one is added or every project is made.
+	u64 *tombstones;
+	u64 tombstoneCount;
+	bool projectsMade;
+	std::mutex tombstoneMutex;
+	std::condition_variable tombstoneQueued;
+
+	// Tombstones are named for the process and the wall clock time, those with this id from this time on are this run's
+	u64 processId;
+	u64 startWallUs;
 
 } app;
 
@@ -113,6 +317,26 @@ static i32 usage( i32 error )
 	printf( "    -v                = Verbose Output\n" );
 	printf( "    -ra               = Print Received Arguments\n" );
 	printf( "    -attempts <num>   = Number of attempts to download archive. (default 6)\n" );
+	printf( "    -backoff <ms> <max-ms> = Delay before the first retry, doubling up to max-ms, with jitter. (default 500 30000)\n" );
+	printf( "    -timeout <sec>    = Give up on an attempt after <sec> seconds. (default none)\n" );
+	printf( "    -low-speed <bytes> <sec> = Give up on an attempt slower than <bytes> per second for <sec> seconds. (default off)\n" );
+	printf( "    -memory <mb>      = Download the archive into memory instead of a temp file, reserving <mb> for it.\n" );
+	printf( "    -stream           = Extract the archive while it downloads.\n" );
+	printf( "    -format <zip|tar.gz> = Archive format to download. (default zip)\n" );
+	printf( "    -connections <n>  = Download the archive in ranges over <n> connections. (default 1)\n" );
+	printf( "    -cache <folder>   = Keep downloaded archives, and their extracted trees, in <folder>. Archives are only downloaded again when changed.\n" );
+	printf( "    -cache-size <mb>  = Most the archive cache can hold before the least recently used are removed. (default 1024)\n" );
+	printf( "    -tree-link <copy|clone|hardlink> = How projects are made from a cached tree. (default clone)\n" );
+	printf( "    -manifest <file>  = Create every project listed in <file>, one per line: <name> <dest-folder> <source> [FIND=REPLACE ...]\n" );
+	printf( "    -var <FIND=REPLACE> = Replace FIND in every project's run.bat and build.bat, can be given more than once.\n" );
+	printf( "    -vars <file>      = Replace every FIND=REPLACE line of <file> in every project, see -var.\n" );
+	printf( "    -threads <n>      = Number of projects created at once with -manifest. (default 4)\n" );
+	printf( "    -extract-threads <n> = Number of threads extracting each archive. (default the cores shared between the projects)\n" );
+	printf( "    -zip-reader <libzip|map> = What reads zip archives, map inflates straight from the mapped archive. (default libzip)\n" );
+	printf( "    -io <stdio|uring> = What writes the extracted files, uring batches small files through io_uring on Linux. (default stdio)\n" );
+	printf( "    -durability <none|file|batch> = What is flushed to the disk before a project is renamed into place. (default none)\n" );
+	printf( "    -incremental      = Update a project that is already there in place from a zip archive, leaving unchanged files alone.\n" );
+	printf( "    -stats json       = Print the timings and throughput of each download as json when done.\n" );
 	printf( "---------------------------------------------------------------------------------------------------------\n" );
 
 	return error;
@@ -145,52 +369,131 @@ static u64 write_data( void *data, u64 size, u64 nmemb, void *stream )
 	return written;
 }
 
-static bool make_directory( const char *directory )
+static u64 write_data_memory( void *data, u64 size, u64 nmemb, void *stream )
 {
-	char pathMem[ MAX_FILEPATH ];
-	if ( string_utf8_copy( pathMem, directory ) == 0 )
-		return false;
+	Buffer *buffer = (Buffer *)stream;
+	u64 bytes = size * nmemb;
 
-	char *path = pathMem;
-	const char *token;
-	const char *delimiters = "./\\";
-	char delim;
-	char dir[ MAX_FILEPATH ] = "\0";
-
-	if ( *path == '.' )
+	// Returning less than requested makes curl abort the transfer
+	if ( !buffer->append( data, bytes ) )
 	{
-		path += 1;
+		log_error( "Archive does not fit in the reserved memory ( %llu MB ), increase -memory.", (unsigned long long)( options.permanentSize / MB( 1 ) ) );
+		return 0;
+	}
 
-		if ( *path == '/' || *path == '\\' )
-		{
-			// ./ (current directory)
-			string_utf8_append( dir, "./" );
-		}
-		else if ( *path == '.' )
-		{
-			path += 1;
+	return bytes;
+}
 
-			// ../ (moving up from current directory)
-			if ( *path == '/' || *path == '\\' )
-			{
-				// ./ (current directory)
-				string_utf8_append( dir, "../" );
-			}
-		}
+// Streamed archives are also written to the cache as they arrive
+struct StreamTarget
+{
+	SOURCE_FORMAT format;
+	ZipStream zipStream;
+	TarStream tarStream;
+	FILE *cacheFile;
+	bool cacheFailed;
+};
+
+static bool stream_target_begin( StreamTarget *target, Allocator *allocator, const char *path )
+{
+	bool sync = options.durability == DURABILITY_FILE;
+
+	if ( target->format == SOURCE_FORMAT_TAR_GZ )
+	{
+		if ( !tar_stream_begin( &target->tarStream, allocator, path ) )
+			return false;
+
+		target->tarStream.syncFiles = sync;
+		return true;
 	}
 
-	path = string_utf8_tokenise( path, delimiters, &token, &delim );
+	if ( !zip_stream_begin( &target->zipStream, allocator, path ) )
+		return false;
+
+	target->zipStream.syncFiles = sync;
+	return true;
+}
+
+static bool stream_target_failed( const StreamTarget *target )
+{
+	if ( target->format == SOURCE_FORMAT_TAR_GZ )
+		return target->tarStream.state == TAR_STREAM_STATE_ERROR;
+
+	return target->zipStream.state == ZIP_STREAM_STATE_ERROR;
+}
+
+static u64 stream_target_bytes_in( const StreamTarget *target )
+{
+	return target->format == SOURCE_FORMAT_TAR_GZ ? target->tarStream.bytesIn : target->zipStream.bytesIn;
+}
+
+static const char *stream_target_comment( const StreamTarget *target )
+{
+	return target->format == SOURCE_FORMAT_TAR_GZ ? target->tarStream.comment : target->zipStream.comment;
+}
+
+static bool stream_target_end( StreamTarget *target )
+{
+	if ( target->format == SOURCE_FORMAT_TAR_GZ )
+		return tar_stream_end( &target->tarStream );
+
+	return zip_stream_end( &target->zipStream );
+}
+
+static void stream_target_free( StreamTarget *target )
+{
+	if ( target->format == SOURCE_FORMAT_TAR_GZ )
+		tar_stream_free( &target->tarStream );
+	else
+		zip_stream_free( &target->zipStream );
+}
+
+static u64 write_data_stream( void *data, u64 size, u64 nmemb, void *stream )
+{
+	StreamTarget *target = (StreamTarget *)stream;
+	u64 bytes = size * nmemb;
+
+	bool written = target->format == SOURCE_FORMAT_TAR_GZ ?
+		tar_stream_write( &target->tarStream, (const u8 *)data, bytes ) :
+		zip_stream_write( &target->zipStream, (const u8 *)data, bytes );
 
-	while ( token )
+	if ( !written )
+		return 0;
+
+	// Not worth failing the download over, it just won't be cached
+	if ( target->cacheFile && fwrite( data, 1, bytes, target->cacheFile ) != bytes )
 	{
-		if ( delim == '.' )
-		{
-			// file ext
+		fclose( target->cacheFile );
+		target->cacheFile = nullptr;
+		target->cacheFailed = true;
+	}
+
+	return bytes;
+}
+
+static bool make_directory( const char *directory )
+{
+	char dir[ MAX_FILEPATH ];
+	if ( string_utf8_copy( dir, directory ) == 0 )
+		return false;
+
+	// Usually the parent is already there, and one call does it
+	#ifdef PLATFORM_WINDOWS
+		if ( _mkdir( dir ) == 0 || errno == EEXIST )
 			return true;
-		}
+	#else
+		if ( mkdir( dir, 0777 ) == 0 || errno == EEXIST )
+			return true;
+	#endif
+
+	// Create each folder along the path, leaving a leading / or drive as is
+	for ( char *c = dir; *c; ++c )
+	{
+		if ( ( *c != '/' && *c != '\\' ) || c == dir || c[ -1 ] == ':' )
+			continue;
 
-		string_utf8_append( dir, token );
-		string_utf8_append( dir, "/" );
+		char separator = *c;
+		*c = '\0';
 
 		#ifdef PLATFORM_WINDOWS
 			_mkdir( dir );
@@ -198,7 +501,17 @@ static bool make_directory( const char *directory )
 			mkdir( dir, 0777 );
 		#endif
 
-		path = string_utf8_tokenise( path, delimiters, &token, &delim );
+		*c = separator;
+	}
+
+	char last = dir[ string_utf8_bytes( dir ) - 2 ];
+	if ( last != '/' && last != '\\' )
+	{
+		#ifdef PLATFORM_WINDOWS
+			_mkdir( dir );
+		#else
+			mkdir( dir, 0777 );
+		#endif
 	}
 
 	return true;
@@ -206,250 +519,2662 @@ static bool make_directory( const char *directory )
 
 static bool delete_directory( const char *directory )
 {
-	DIR *dir = opendir( directory );
-	if ( !dir )
-		return false;
+	// Shares the threads a project extracts with, it is usually removing one being replaced
+	u64 removed = 0;
+	bool deleted = tree_remove( directory, max<u64>( app.extractThreads, 1 ), &removed );
+
+	if ( removed > 0 )
+		log( "Removed %llu files and folders from %s", (unsigned long long)removed, directory );
 
-	struct dirent *entry;
+	return deleted;
+}
+
+// Opens the source's archive, from memory, the cache or the downloaded file
+static zip_t *open_source_archive( Source *source )
+{
+	zip *z = nullptr;
 
-	while ( ( entry = readdir( dir ) ) != NULL)
+	if ( options.inMemory && !source->cacheHit )
 	{
-		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
-			continue;
+		zip_error_t error;
+		zip_error_init( &error );
 
-		if ( entry->d_type == DT_DIR )
+		zip_source_t *zipSource = zip_source_buffer_create( source->archive.data, source->archive.size, 0, &error );
+		if ( zipSource )
 		{
-			char subdirectoryPath[ MAX_FILEPATH ];
-			string_utf8_copy( subdirectoryPath, directory );
-			string_utf8_append( subdirectoryPath, "/" );
-			string_utf8_append( subdirectoryPath, entry->d_name );
+			z = zip_open_from_source( zipSource, ZIP_RDONLY, &error );
+			if ( !z )
+				zip_source_free( zipSource );
+		}
+
+		if ( !z )
+			log_error( "Cannot open zip archive from memory: %s", zip_error_strerror( &error ) );
+
+		zip_error_fini( &error );
+	}
+	else
+	{
+		const char *archivePath = source->cacheHit ? source->cached.archivePath : source->archivePath;
+		i32 err = 0;
+		z = zip_open( archivePath, ZIP_RDONLY, &err );
 
-			delete_directory( subdirectoryPath );
+		if ( !z )
+		{
+			zip_error_t error;
+			zip_error_init_with_code( &error, err );
+			log_error( "Cannot open zip archive '%s': %s", archivePath, zip_error_strerror( &error ) );
+			zip_error_fini( &error );
 		}
 	}
 
-	closedir( dir );
+	return z;
+}
 
-	dir = opendir( directory );
-	if ( !dir )
-		return false;
+// Maps the source's archive, from memory, the cache or the downloaded file
+static bool map_source_archive( Source *source, ZipMap *map )
+{
+	if ( options.inMemory && !source->cacheHit )
+		return zip_map_open_memory( map, source->archive.data, source->archive.size );
 
-	while ( ( entry = readdir( dir ) ) != NULL )
-	{
-		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
-			continue;
+	return zip_map_open_file( map, source->cacheHit ? source->cached.archivePath : source->archivePath );
+}
 
-		char filePath[ MAX_FILEPATH ];
-		string_utf8_copy( filePath, directory );
-		string_utf8_append( filePath, "/" );
-		string_utf8_append( filePath, entry->d_name );
+// A file to extract and its estimated cost, roughly the bytes written plus a fixed cost per file
+// The folder was made while listing the entries, the file is opened relative to it.
+// The first skip bytes of the name are the archive's root folder, which is left out.
+struct ExtractEntry
+{
+	zip_uint64_t index;
+	u64 cost;
+	const DirectoryCacheEntry *folder;
+	u64 skip;
+};
 
-		#ifdef PLATFORM_WINDOWS
-			_unlink( filePath );
-		#else
-			unlink( filePath );
-		#endif
-	}
+// A run of entries extracted by one thread, large files get one each, small ones are batched
+struct ExtractTask
+{
+	u64 first;
+	u64 count;
+	u64 cost;
+};
 
-	closedir( dir );
+struct ExtractWorker
+{
+	u8 *buffer;
+	u64 busyUs;
+	u64 longestTaskUs;
+
+	// Reused for every entry the thread inflates from the map
+	z_stream inflater;
+	bool inflaterActive;
+
+	// Small files are queued here and written in batches, when io_uring is there
+	UringWriter uring;
+	u8 *uringBuffer;
+	bool uringActive;
+};
 
-	i32 result = 0;
+struct ExtractFileSlot
+{
+	u64 hash;
+	zip_uint64_t index;
+	u64 skip;
+};
 
-	#ifdef PLATFORM_WINDOWS
-		result = _rmdir( directory );
-	#else
-		result = rmdir( directory );
-	#endif
+struct ExtractFileSet
+{
+	ExtractFileSlot *slots;
+	u64 capacity;
+	zip_t *zip;
+	const ZipMap *map;
+};
 
-	return result == 0;
-}
+// The paths an archive has below its root folder, as lines for a project's record, so a later update in place only
+// removes what this revision wrote. On the heap, an archive can have any number.
+struct ExtractFileList
+{
+	char *data;
+	u64 bytes;
+	u64 capacity;
+};
 
-static bool extract_all_files( zip_t *zip, const char *path, char *rootFolder, u64 maxRootFolder )
+// Shared by the threads extracting one archive
+// Without libzip every entry is read from the map
+struct ExtractJob
 {
-	if ( !make_directory( path ) )
-		return false;
+	Source *source;
+	const char *path;
+	const ZipMap *map;
+	bool libzip;
+	bool incremental;
+	const ExtractEntry *entries;
+	const ExtractTask *tasks;
+	u64 taskCount;
+	std::atomic<u64> next;
+	std::atomic<u64> failed;
+	std::atomic<u64> unchanged;
+	ExtractWorker workers[ MAX_THREADS ];
+};
 
-	struct zip_stat st;
-	char prePath[ MAX_FILEPATH ];
-	char filePath[ MAX_FILEPATH ];
-	char buf[ 1024 ];
+// Copies a stored entry straight from the archive to the file, without passing it through a buffer
+// @return false if it could not be copied, the caller falls back to reading it another way
+static bool extract_stored_file( const ZipMap *map, zip_uint64_t index, FILE *fp, const char *name, bool *failed )
+{
+	u64 size = map->uncompressedSizes[ index ];
 
-	i32 err = zip_stat_index( zip, 0, 0, &st );
-	if ( err != 0 )
-	{
-		log_error( "Error getting file stat." );
+	const u8 *data = zip_map_stored_data( map, index, size );
+	if ( !data || map->compressedSizes[ index ] != size )
 		return false;
-	}
 
-	if ( st.name[ strlen( st.name ) - 1 ] == '/' )
+	// Read from the mapping, nothing is copied to check it
+	if ( crc32_z( crc32( 0, nullptr, 0 ), data, size ) != map->crcs[ index ] )
 	{
-		string_utf8_copy( rootFolder, maxRootFolder, path );
-		string_utf8_append( rootFolder, maxRootFolder, st.name );
+		log_error( "CRC mismatch for archive entry: %s", name );
+		*failed = true;
+		return true;
 	}
 
-	string_utf8_copy( prePath, path );
+	u64 copied = 0;
 
-	for ( zip_int64_t i = 0, fileCount = zip_get_num_entries( zip, 0 ); i < fileCount; ++i )
-	{
-		err = zip_stat_index( zip, i, 0, &st );
-		if ( err != 0 )
+	#ifdef PLATFORM_LINUX
+		// The kernel copies between the files, and may share the blocks on filesystems that can
+		if ( map->fd >= 0 )
 		{
-			log_error( "Error getting file stat." );
-			return false;
+			loff_t offset = static_cast<loff_t>( data - map->data );
+			ssize_t result;
+
+			while ( copied < size && ( result = copy_file_range( map->fd, &offset, fileno( fp ), nullptr, size - copied, 0 ) ) > 0 )
+				copied += static_cast<u64>( result );
 		}
+	#endif
 
-		string_utf8_copy( filePath, prePath );
-		string_utf8_append( filePath, st.name );
+	// Whatever copy_file_range didn't do is written from the mapping in one go
+	if ( copied < size && fwrite( data + copied, 1, size - copied, fp ) != size - copied )
+	{
+		log_error( "Error writing file: %s", name );
+		*failed = true;
+	}
 
-		if ( st.name[ strlen( st.name ) - 1 ] != '/' )
-		{
-			// File
-			FILE *fp = fopen( filePath, "wb" );
-			if ( !fp )
-			{
-				log_error( "Error opening file: %s", filePath );
-				return false;
-			}
+	return true;
+}
 
-			// Extract the file contents.
-			zip_file_t *zf = zip_fopen_index( zip, i, 0 );
-			if ( !zf )
-			{
-				log_error( "Error opening file in archive: %s", st.name );
-				return false;
-			}
+// Opens an entry's file relative to its folder's fd when there is one, so only the part of the name below it is looked up
+static FILE *open_entry_file( const char *path, const DirectoryCacheEntry *folder, const char *name, bool write )
+{
+	FILE *fp = nullptr;
 
-			u64 nread;
+	if ( folder && folder->fd >= 0 )
+	{
+		#ifndef PLATFORM_WINDOWS
+			i32 fd = openat( folder->fd, name + folder->skip, write ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0666 );
 
-			while ( ( nread = zip_fread( zf, buf, sizeof( buf ) ) ) > 0 )
-			{
-				fwrite( buf, 1, nread, fp );
-			}
+			if ( fd >= 0 && !( fp = fdopen( fd, write ? "wb" : "rb" ) ) )
+				close( fd );
+		#endif
+	}
+	else
+	{
+		char filePath[ MAX_FILEPATH ];
+		string_utf8_format( filePath, "%s%s", path, name );
 
-			// Close the files.
-			fclose( fp );
-			zip_fclose( zf );
-		}
-		else
-		{
-			// Folder
-			if ( !make_directory( filePath ) )
-				return false;
-		}
+		fp = fopen( filePath, write ? "wb" : "rb" );
 	}
 
-	return true;
+	return fp;
 }
 
-static void replace_entry_in_file( const char *file, const char *findString, const char *newString )
+// Opens a file to extract an entry of the given size to, size 0 when it isn't known
+static FILE *open_extract_file( const char *path, const DirectoryCacheEntry *folder, const char *name, u64 size, u64 bufferSize )
 {
-	char filePath[ MAX_FILEPATH ];
+	FILE *fp = open_entry_file( path, folder, name, true );
 
-	string_utf8_copy( filePath, options.finalProjectFolder );
-	string_utf8_append( filePath, file );
-
-	// Read the file into memory
-	FILE *fp = fopen( filePath, "rb" );
 	if ( !fp )
 	{
-		log_error( "Failed to open file for reading: %s", filePath );
-		return;
+		log_error( "Error opening file: %s%s", path, name );
+		return nullptr;
 	}
 
-	fseek( fp, 0, SEEK_END );
-	u64 fileSize = ftell( fp );
-	fseek( fp, 0, SEEK_SET );
+	// The writes are already large, stdio's buffer would only split them up
+	setvbuf( fp, nullptr, _IONBF, 0 );
+
+	#ifdef PLATFORM_LINUX
+		// Reserve a file that takes more than one write up front, so it is laid out in one go and a full disk fails before inflating.
+		// fallocate rather than posix_fallocate, which writes zeros when the filesystem can't reserve space.
+		if ( size > bufferSize && fallocate( fileno( fp ), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>( size ) ) != 0 && errno == ENOSPC )
+		{
+			log_error( "Not enough space to extract: %s%s", path, name );
+			fclose( fp );
+			return nullptr;
+		}
+	#else
+		(void)size;
+		(void)bufferSize;
+	#endif
+
+	return fp;
+}
 
-	u64 bufferDestSize = fileSize * 2;
-	char *bufferSrc = app.memoryArena.transient.allocate<char>( fileSize );
-	char *bufferDest = app.memoryArena.transient.allocate<char>( bufferDestSize );
+// Extracts an entry using only the map, stored entries are copied and the rest inflated straight from the mapping
+static bool extract_mapped_file( const ZipMap *map, zip_uint64_t index, const char *path, const DirectoryCacheEntry *folder, u64 skip, ExtractWorker *worker )
+{
+	// Names in the map are not null terminated
+	char name[ MAX_FILEPATH ];
 
-	u64 read = fread( bufferSrc, 1, fileSize, fp );
-	if ( read != fileSize )
+	if ( map->nameBytes[ index ] >= sizeof( name ) )
 	{
-		log_error( "Failed to read file fully: %s ( %d / %d )", filePath, read, fileSize );
-		return;
+		log_error( "Path too long for archive entry %llu.", (unsigned long long)index );
+		return false;
 	}
 
-	fclose( fp );
+	string_utf8_copy( name, zip_map_name( map, index ), map->nameBytes[ index ] );
+
+	FILE *fp = open_extract_file( path, folder, name + skip, map->uncompressedSizes[ index ], EXTRACT_CHUNK_SIZE );
+	if ( !fp )
+		return false;
 
-	u64 findStringSize = string_utf8_bytes( findString ) - 1;
-	u64 newStringSize = string_utf8_bytes( newString ) - 1;
-	u64 destIdx = 0;
+	bool failed = false;
 
-	for ( u64 i = 0; i < fileSize; ++i )
+	if ( !extract_stored_file( map, index, fp, name, &failed ) )
+		failed = !zip_map_extract( map, index, fp, &worker->inflater, &worker->inflaterActive, worker->buffer, EXTRACT_CHUNK_SIZE );
+
+	if ( !close_file( fp, options.durability == DURABILITY_FILE ) && !failed )
 	{
-		// Most won't match, check and move on
-		if ( bufferSrc[ i ] != findString[ 0 ] )
-		{
-			bufferDest[ destIdx++ ] = bufferSrc[ i ];
-			continue;
-		}
+		log_error( "Error writing file: %s%s", path, name + skip );
+		failed = true;
+	}
 
-		u64 matchStart = i;
-		bool matched = true;
+	return !failed;
+}
 
-		for ( u64 k = 1; k < findStringSize; ++k )
-		{
-			if ( bufferSrc[ ++i ] != findString[ k ] )
-			{
-				matched = false;
-				break;
-			}
-		}
+// Entries are inflated into the buffer until it is full before writing, one that fits is written with a single call
+static bool extract_file( zip_t *zip, zip_uint64_t index, const char *path, const DirectoryCacheEntry *folder, u64 skip, u8 *buffer, u64 bufferSize, const ZipMap *map )
+{
+	struct zip_stat st;
 
-		if ( matched )
-		{
-			if ( destIdx + newStringSize > bufferDestSize )
-			{
-				bufferDestSize *= 2;
-				bufferDest = app.memoryArena.transient.reallocate<char>( bufferDest, bufferDestSize );
-				if ( !bufferDest )
-				{
-					app.memoryArena.transient.free( bufferDest );
-					app.memoryArena.transient.free( bufferSrc );
-					log_error( "Buffer not big enough to handle insertion (failed to allocate more)." );
-					return;
-				}
-			}
+	if ( zip_stat_index( zip, index, 0, &st ) != 0 )
+	{
+		log_error( "Error getting file stat for entry %llu.", (unsigned long long)index );
+		return false;
+	}
 
-			for ( u64 newIdx = 0; newIdx < newStringSize; ++newIdx )
-			{
-				bufferDest[ destIdx++ ] = newString[ newIdx ];
-			}
-		}
-		else
+	FILE *fp = open_extract_file( path, folder, st.name + skip, ( st.valid & ZIP_STAT_SIZE ) ? st.size : 0, bufferSize );
+	if ( !fp )
+		return false;
+
+	// Stored entries come straight from the mapped archive
+	bool failed = false;
+
+	if ( map && index < map->entryCount && extract_stored_file( map, index, fp, st.name, &failed ) )
+	{
+		if ( !close_file( fp, options.durability == DURABILITY_FILE ) && !failed )
 		{
-			for ( ; matchStart < i; ++matchStart )
-			{
-				bufferDest[ destIdx++ ] = bufferSrc[ matchStart ];
-			}
+			log_error( "Error writing file: %s%s", path, st.name + skip );
+			failed = true;
 		}
+
+		return !failed;
 	}
 
-	// Writing the updated data back to file
-	fp = fopen( filePath, "wb" );
-	if ( !fp )
+	// Extract the file contents.
+	zip_file_t *zf = zip_fopen_index( zip, index, 0 );
+	if ( !zf )
 	{
-		log_error( "Failed to open file for writing: %s", file );
-		return;
+		log_error( "Error opening file in archive: %s", st.name );
+		fclose( fp );
+		return false;
 	}
 
-	u64 bytesWritten = fwrite( bufferDest, 1, destIdx, fp );
+	zip_int64_t nread = 0;
+	bool written = true;
 
-	if ( bytesWritten != destIdx )
+	do
 	{
-		fclose( fp );
-		app.memoryArena.transient.free( bufferDest );
-		app.memoryArena.transient.free( bufferSrc );
-		log_error( "Failed to write all bytes ( %d / %d ) to file: %s", bytesWritten, destIdx, file );
-		return;
-	}
+		u64 filled = 0;
 
-	fclose( fp );
+		while ( filled < bufferSize && ( nread = zip_fread( zf, buffer + filled, bufferSize - filled ) ) > 0 )
+			filled += nread;
 
-	app.memoryArena.transient.free( bufferDest );
-	app.memoryArena.transient.free( bufferSrc );
+		if ( filled > 0 )
+			written = fwrite( buffer, 1, filled, fp ) == filled;
+	}
+	while ( written && nread > 0 );
+
+	// Close the files.
+	written = close_file( fp, options.durability == DURABILITY_FILE ) && written;
+	zip_fclose( zf );
+
+	if ( nread < 0 )
+	{
+		log_error( "Error reading file in archive: %s", st.name );
+		return false;
+	}
+
+	if ( !written )
+	{
+		log_error( "Error writing file: %s%s", path, st.name + skip );
+		return false;
+	}
+
+	return true;
+}
+
+// A file already on disk with the entry's size and CRC is left alone, and keeps its modified time
+static bool extract_unchanged( const char *path, const DirectoryCacheEntry *folder, const char *name, u64 size, u32 crc, u8 *buffer, u64 bufferSize )
+{
+	FILE *fp = open_entry_file( path, folder, name, false );
+	if ( !fp )
+		return false;
+
+	bool unchanged = true;
+
+	#ifndef PLATFORM_WINDOWS
+		// Most changed files are a different size, they aren't read at all
+		struct stat st;
+		unchanged = fstat( fileno( fp ), &st ) == 0 && static_cast<u64>( st.st_size ) == size;
+	#endif
+
+	u32 fileCrc = crc32( 0, nullptr, 0 );
+	u64 total = 0;
+	u64 bytes;
+
+	setvbuf( fp, nullptr, _IONBF, 0 );
+
+	while ( unchanged && ( bytes = fread( buffer, 1, bufferSize, fp ) ) > 0 )
+	{
+		fileCrc = crc32_z( fileCrc, buffer, bytes );
+		total += bytes;
+		unchanged = total <= size;
+	}
+
+	unchanged = unchanged && !ferror( fp ) && total == size && fileCrc == crc;
+	fclose( fp );
+
+	// Written again as a new file, not through a hard link into the tree cache
+	if ( !unchanged )
+	{
+		#ifndef PLATFORM_WINDOWS
+			if ( folder && folder->fd >= 0 )
+			{
+				unlinkat( folder->fd, name + folder->skip, 0 );
+				return false;
+			}
+		#endif
+
+		char filePath[ MAX_FILEPATH ];
+		string_utf8_format( filePath, "%s%s", path, name );
+		remove( filePath );
+	}
+
+	return unchanged;
+}
+
+// The size and CRC the archive has for an entry, from the map when there is no libzip handle
+static bool extract_entry_unchanged( const ExtractJob *job, zip_t *zip, const ExtractEntry *entry, ExtractWorker *worker )
+{
+	if ( !zip )
+	{
+		const ZipMap *map = job->map;
+		char name[ MAX_FILEPATH ];
+
+		if ( map->nameBytes[ entry->index ] >= sizeof( name ) )
+			return false;
+
+		string_utf8_copy( name, zip_map_name( map, entry->index ), map->nameBytes[ entry->index ] );
+
+		return extract_unchanged( job->path, entry->folder, name + entry->skip, map->uncompressedSizes[ entry->index ], map->crcs[ entry->index ], worker->buffer, EXTRACT_CHUNK_SIZE );
+	}
+
+	struct zip_stat st;
+
+	if ( zip_stat_index( zip, entry->index, 0, &st ) != 0 || !( st.valid & ZIP_STAT_SIZE ) || !( st.valid & ZIP_STAT_CRC ) )
+		return false;
+
+	return extract_unchanged( job->path, entry->folder, st.name + entry->skip, st.size, st.crc, worker->buffer, EXTRACT_CHUNK_SIZE );
+}
+
+// Name and size of an entry, from the map when there is no libzip handle
+static bool extract_entry_stat( zip_t *zip, const ZipMap *map, zip_uint64_t index, char *name, u64 maxName, u64 *size )
+{
+	if ( !zip )
+	{
+		if ( map->nameBytes[ index ] >= maxName )
+			return false;
+
+		string_utf8_copy( name, maxName, zip_map_name( map, index ), map->nameBytes[ index ] );
+		*size = map->uncompressedSizes[ index ];
+
+		return true;
+	}
+
+	struct zip_stat st;
+
+	if ( zip_stat_index( zip, index, 0, &st ) != 0 )
+		return false;
+
+	string_utf8_copy( name, maxName, st.name );
+	*size = ( st.valid & ZIP_STAT_SIZE ) ? st.size : 0;
+
+	return true;
+}
+
+// CRC of an entry, from the map when there is no libzip handle
+static bool extract_entry_crc( zip_t *zip, const ZipMap *map, zip_uint64_t index, u32 *crc )
+{
+	if ( !zip )
+	{
+		*crc = map->crcs[ index ];
+		return true;
+	}
+
+	struct zip_stat st;
+
+	if ( zip_stat_index( zip, index, 0, &st ) != 0 || !( st.valid & ZIP_STAT_CRC ) )
+		return false;
+
+	*crc = st.crc;
+
+	return true;
+}
+
+// Name of an entry as the archive has it, from the map when there is no libzip handle, where it isn't terminated
+static const char *extract_entry_name( zip_t *zip, const ZipMap *map, zip_uint64_t index, u64 *bytes )
+{
+	if ( !zip )
+	{
+		*bytes = map->nameBytes[ index ];
+		return zip_map_name( map, index );
+	}
+
+	const char *name = zip_get_name( zip, index, 0 );
+	*bytes = name ? string_utf8_bytes( name ) - 1 : 0;
+
+	return name;
+}
+
+static bool extract_entry( const ExtractJob *job, zip_t *zip, const ExtractEntry *entry, ExtractWorker *worker )
+{
+	return job->libzip ?
+		extract_file( zip, entry->index, job->path, entry->folder, entry->skip, worker->buffer, EXTRACT_CHUNK_SIZE, job->map ) :
+		extract_mapped_file( job->map, entry->index, job->path, entry->folder, entry->skip, worker );
+}
+
+// Writes the files queued on the worker's ring, those that fail are written again the usual way
+static void extract_flush_queued( ExtractJob *job, zip_t *zip, ExtractWorker *worker )
+{
+	UringWriter *uring = &worker->uring;
+	u64 failed = uring_writer_flush( uring );
+
+	for ( u64 i = 0; i < uring->fileCount && failed > 0; ++i )
+	{
+		if ( uring->files[ i ].failed && !extract_entry( job, zip, &job->entries[ uring->files[ i ].user ], worker ) )
+			job->failed.fetch_add( 1 );
+	}
+
+	// Nothing got through, the kernel can't do what the ring asks of it
+	if ( failed > 0 && failed == uring->fileCount )
+	{
+		log_error( "Writing files through io_uring failed, using stdio." );
+		worker->uringActive = false;
+	}
+
+	uring_writer_reset( uring );
+}
+
+// Queues a small entry on the worker's ring, stored entries are written from the mapping and the rest read into the ring's buffer
+// @return false if it could not be queued, the caller extracts it the usual way
+static bool extract_queue_file( ExtractJob *job, zip_t *zip, u64 entryIndex, ExtractWorker *worker, bool *failed )
+{
+	const ExtractEntry *entry = &job->entries[ entryIndex ];
+	const ZipMap *map = job->map;
+	char name[ MAX_FILEPATH ];
+	u64 size;
+
+	if ( !extract_entry_stat( zip, map, entry->index, name, sizeof( name ), &size ) || size > URING_WRITER_MAX_FILE_SIZE )
+		return false;
+
+	// Relative to the folder's fd like any other file, by its full path when the folder has none
+	char filePath[ MAX_FILEPATH ];
+	const char *fileName = name + entry->skip;
+	i32 dirFd = AT_FDCWD;
+
+	if ( entry->folder && entry->folder->fd >= 0 )
+	{
+		dirFd = entry->folder->fd;
+		fileName += entry->folder->skip;
+	}
+	else
+	{
+		string_utf8_format( filePath, "%s%s", job->path, fileName );
+		fileName = filePath;
+	}
+
+	u64 nameBytes = string_utf8_bytes( fileName ) - 1;
+
+	// One byte over, so the whole of the entry is known to fit when it is inflated
+	if ( !uring_writer_room( &worker->uring, size + 1, nameBytes ) )
+	{
+		extract_flush_queued( job, zip, worker );
+
+		if ( !worker->uringActive || !uring_writer_room( &worker->uring, size + 1, nameBytes ) )
+			return false;
+	}
+
+	const u8 *data = map && entry->index < map->entryCount && map->compressedSizes[ entry->index ] == size ? zip_map_stored_data( map, entry->index, size ) : nullptr;
+
+	if ( data && crc32_z( crc32( 0, nullptr, 0 ), data, size ) != map->crcs[ entry->index ] )
+	{
+		log_error( "CRC mismatch for archive entry: %s", name );
+		*failed = true;
+		return true;
+	}
+
+	if ( !data && !zip )
+	{
+		u8 *buffer = uring_writer_reserve( &worker->uring, size + 1 );
+
+		if ( !zip_map_extract( map, entry->index, nullptr, &worker->inflater, &worker->inflaterActive, buffer, size + 1 ) )
+		{
+			*failed = true;
+			return true;
+		}
+
+		data = buffer;
+	}
+	else if ( !data )
+	{
+		u8 *buffer = uring_writer_reserve( &worker->uring, size + 1 );
+
+		zip_file_t *zf = zip_fopen_index( zip, entry->index, 0 );
+		if ( !zf )
+		{
+			log_error( "Error opening file in archive: %s", name );
+			*failed = true;
+			return true;
+		}
+
+		// Reading past the end is what has libzip check the CRC
+		zip_int64_t nread = 0;
+		u64 filled = 0;
+
+		while ( filled <= size && ( nread = zip_fread( zf, buffer + filled, size + 1 - filled ) ) > 0 )
+			filled += nread;
+
+		zip_fclose( zf );
+
+		if ( nread < 0 || filled != size )
+		{
+			log_error( "Error reading file in archive: %s", name );
+			*failed = true;
+			return true;
+		}
+
+		data = buffer;
+	}
+
+	uring_writer_add( &worker->uring, dirFd, fileName, nameBytes, data, size, entryIndex );
+
+	return true;
+}
+
+// Takes the next task until there are none left, a failed entry is reported and the rest carry on
+static void extract_files( ExtractJob *job, zip_t *zip, u64 worker )
+{
+	for ( ;; )
+	{
+		u64 next = job->next.fetch_add( 1 );
+
+		if ( next >= job->taskCount )
+		{
+			// Whatever is still queued is written before the thread is done
+			if ( job->workers[ worker ].uringActive )
+			{
+				u64 start = time_now_us();
+				extract_flush_queued( job, zip, &job->workers[ worker ] );
+				job->workers[ worker ].busyUs += time_now_us() - start;
+			}
+
+			return;
+		}
+
+		const ExtractTask *task = &job->tasks[ next ];
+		u64 start = time_now_us();
+
+		for ( u64 i = task->first; i < task->first + task->count; ++i )
+		{
+			const ExtractEntry *entry = &job->entries[ i ];
+
+			if ( job->incremental && extract_entry_unchanged( job, zip, entry, &job->workers[ worker ] ) )
+			{
+				job->unchanged.fetch_add( 1 );
+				continue;
+			}
+
+			bool failed = false;
+
+			if ( job->workers[ worker ].uringActive && extract_queue_file( job, zip, i, &job->workers[ worker ], &failed ) )
+			{
+				if ( failed )
+					job->failed.fetch_add( 1 );
+
+				continue;
+			}
+
+			if ( !extract_entry( job, zip, entry, &job->workers[ worker ] ) )
+				job->failed.fetch_add( 1 );
+		}
+
+		u64 duration = time_now_us() - start;
+
+		job->workers[ worker ].busyUs += duration;
+		job->workers[ worker ].longestTaskUs = max( job->workers[ worker ].longestTaskUs, duration );
+	}
+}
+
+// libzip handles can't be shared between threads, each worker opens its own over the same archive.
+// The map is read only and shared as it is.
+static void extract_files_worker( ExtractJob *job, u64 worker )
+{
+	if ( !job->libzip )
+	{
+		extract_files( job, nullptr, worker );
+		return;
+	}
+
+	zip_t *zip = open_source_archive( job->source );
+
+	if ( !zip )
+		return;
+
+	extract_files( job, zip, worker );
+	zip_close( zip );
+}
+
+// Largest first
+static i32 extract_entry_compare( const void *lhs, const void *rhs )
+{
+	u64 a = ( (const ExtractEntry *)lhs )->cost;
+	u64 b = ( (const ExtractEntry *)rhs )->cost;
+
+	return a < b ? 1 : ( a > b ? -1 : 0 );
+}
+
+// Longest processing time first, so a big file is never left to start last while the other threads sit idle.
+// Small files that follow are batched so each task is worth taking.
+static u64 extract_schedule( ExtractEntry *entries, u64 entryCount, ExtractTask *tasks )
+{
+	qsort( entries, entryCount, sizeof( ExtractEntry ), extract_entry_compare );
+
+	u64 taskCount = 0;
+
+	for ( u64 i = 0; i < entryCount; ++i )
+	{
+		ExtractTask *task = taskCount ? &tasks[ taskCount - 1 ] : nullptr;
+
+		if ( !task || task->cost + entries[ i ].cost > EXTRACT_BATCH_COST || task->count >= EXTRACT_BATCH_MAX_FILES )
+		{
+			task = &tasks[ taskCount++ ];
+			*task = { .first = i, .count = 0, .cost = 0 };
+		}
+
+		task->count += 1;
+		task->cost += entries[ i ].cost;
+	}
+
+	return taskCount;
+}
+
+// Makes an entry's folder, or a file's parent, through the cache. By its full path if the cache has no room, and then there's no folder.
+static bool extract_make_folder( DirectoryCache *cache, const char *path, const char *name, u64 bytes, const DirectoryCacheEntry **folder )
+{
+	*folder = directory_cache_make( cache, name, bytes );
+
+	if ( *folder )
+		return true;
+
+	char folderPath[ MAX_FILEPATH ];
+	u64 pathBytes = string_utf8_copy( folderPath, path );
+
+	if ( pathBytes + bytes >= sizeof( folderPath ) )
+		return false;
+
+	string_utf8_copy( folderPath + pathBytes, sizeof( folderPath ) - pathBytes, name, bytes );
+
+	return make_directory( folderPath );
+}
+
+// Adds a path to the lines of a project's record, a path left out is never removed by a later update
+static void extract_file_list_add( ExtractFileList *list, const char *relative, u64 bytes )
+{
+	if ( memchr( relative, '\n', bytes ) )
+		return;
+
+	u64 needed = list->bytes + 5 + bytes + 1;
+
+	if ( needed > list->capacity )
+	{
+		u64 capacity = max<u64>( max<u64>( list->capacity * 2, needed ), KB( 64 ) );
+		char *data = (char *)realloc( list->data, capacity );
+
+		if ( !data )
+			return;
+
+		list->data = data;
+		list->capacity = capacity;
+	}
+
+	memcpy( list->data + list->bytes, "file ", 5 );
+	memcpy( list->data + list->bytes + 5, relative, bytes );
+	list->data[ needed - 1 ] = '\n';
+	list->bytes = needed;
+}
+
+// Roughly how many folders an archive has, each run of entries in the same folder counts once.
+// It only sizes the directory cache, folders past its room are made by their path.
+static u64 extract_folder_estimate( zip_t *zip, const ZipMap *map, u64 entryCount )
+{
+	u64 folders = 1;
+	const char *last = nullptr;
+	u64 lastBytes = 0;
+
+	for ( u64 i = 0; i < entryCount; ++i )
+	{
+		u64 bytes;
+		const char *name = extract_entry_name( zip, map, i, &bytes );
+
+		if ( !name )
+			continue;
+
+		// With its trailing separator, a folder entry is its own folder
+		while ( bytes > 0 && name[ bytes - 1 ] != '/' )
+			--bytes;
+
+		if ( !last || bytes != lastBytes || memcmp( name, last, bytes ) != 0 )
+			folders += 1;
+
+		last = name;
+		lastBytes = bytes;
+	}
+
+	return folders;
+}
+
+// Open addressing set of the files an archive has by the hash of their path below its root folder, 0 marks an empty slot.
+// Each slot keeps its entry, so a path whose hash is found is still compared in full with the entry's name.
+static void extract_file_insert( ExtractFileSet *files, const char *relative, u64 bytes, zip_uint64_t index, u64 skip )
+{
+	u64 hash = directory_cache_hash( relative, bytes );
+	hash = hash ? hash : 1;
+
+	u64 i = hash & ( files->capacity - 1 );
+
+	while ( files->slots[ i ].hash != 0 )
+		i = ( i + 1 ) & ( files->capacity - 1 );
+
+	files->slots[ i ] = { .hash = hash, .index = index, .skip = skip };
+}
+
+[[nodiscard]] static bool extract_file_find( const ExtractFileSet *files, const char *relative, u64 bytes )
+{
+	u64 hash = directory_cache_hash( relative, bytes );
+	hash = hash ? hash : 1;
+
+	for ( u64 i = hash & ( files->capacity - 1 ); files->slots[ i ].hash != 0; i = ( i + 1 ) & ( files->capacity - 1 ) )
+	{
+		const ExtractFileSlot *slot = &files->slots[ i ];
+
+		if ( slot->hash != hash )
+			continue;
+
+		u64 nameBytes;
+		const char *name = extract_entry_name( files->zip, files->map, slot->index, &nameBytes );
+
+		if ( name && nameBytes == slot->skip + bytes && memcmp( name + slot->skip, relative, bytes ) == 0 )
+			return true;
+	}
+
+	return false;
+}
+
+// Removes what the last revision of the template wrote and this one doesn't have, from the paths listed in the project's record.
+// Nothing else in the project is touched, build output and the user's own files stay. A folder only goes once it is empty.
+static u64 extract_remove_stale( const char *path, const ExtractFileSet *files )
+{
+	char recordPath[ MAX_FILEPATH ];
+	string_utf8_format( recordPath, "%s%s", path, PROJECT_RECORD_FILE );
+
+	FILE *record = fopen( recordPath, "rb" );
+	if ( !record )
+		return 0;
+
+	char line[ MAX_FILEPATH + 8 ];
+	u64 removed = 0;
+
+	while ( fgets( line, sizeof( line ), record ) )
+	{
+		u64 bytes = string_utf8_bytes( line ) - 1;
+
+		while ( bytes > 0 && ( line[ bytes - 1 ] == '\n' || line[ bytes - 1 ] == '\r' ) )
+			line[ --bytes ] = '\0';
+
+		if ( bytes <= 5 || strncmp( line, "file ", 5 ) != 0 )
+			continue;
+
+		const char *relative = line + 5;
+		bytes -= 5;
+
+		// Then each folder it was in that the archive doesn't have either, until one isn't empty
+		while ( bytes > 0 && !extract_file_find( files, relative, bytes ) )
+		{
+			char childPath[ MAX_FILEPATH ];
+			string_utf8_format( childPath, "%s%.*s", path, (i32)bytes, relative );
+
+			bool folder = relative[ bytes - 1 ] == '/';
+
+			#ifdef PLATFORM_WINDOWS
+				bool gone = folder ? _rmdir( childPath ) == 0 : remove( childPath ) == 0;
+			#else
+				bool gone = folder ? rmdir( childPath ) == 0 : remove( childPath ) == 0;
+			#endif
+
+			if ( !gone )
+				break;
+
+			log( "Removed %s", childPath );
+			removed += 1;
+
+			bytes -= folder ? 1 : 0;
+
+			while ( bytes > 0 && relative[ bytes - 1 ] != '/' )
+				--bytes;
+		}
+	}
+
+	fclose( record );
+
+	return removed;
+}
+
+// Folders are made first, then the files are scheduled across the threads. Everything goes in path, without the archive's root folder.
+// With a map, stored entries are copied from it directly. Without libzip everything is read from the map.
+// Incremental updates a project already in path, files that are the same are not written and those the last revision wrote that
+// this one doesn't have are removed. With fileList, every path the archive has is listed for the project's record.
+// The setup files' records are made again from the archive, one the archive and the file written still match is kept as it is.
+static bool extract_all_files( Source *source, zip_t *zip, const ZipMap *map, const char *path, bool incremental, Allocator *allocator, u64 threads,
+	ExtractStats *stats, SetupFileRecord *setupFiles, ExtractFileList *fileList )
+{
+	char name[ MAX_FILEPATH ];
+	char root[ MAX_FILEPATH ];
+	u64 size = 0;
+
+	if ( !extract_entry_stat( zip, map, 0, name, sizeof( name ), &size ) )
+	{
+		log_error( "Error getting file stat." );
+		return false;
+	}
+
+	u64 rootBytes = archive_root_bytes( name );
+	string_utf8_copy( root, name, rootBytes );
+
+	u64 wallStart = time_now_us();
+	u64 entryCount = zip ? static_cast<u64>( zip_get_num_entries( zip, 0 ) ) : map->entryCount;
+
+	// The files and folders the archive has, to find those it doesn't when updating in place
+	u64 hashCapacity = 64;
+
+	while ( incremental && hashCapacity < entryCount * 2 )
+		hashCapacity *= 2;
+
+	// One of each for every entry, from the heap as an archive can have any number and the transient arena is fixed in size
+	ExtractEntry *entries = (ExtractEntry *)malloc( sizeof( ExtractEntry ) * max<u64>( entryCount, 1 ) );
+	ExtractTask *tasks = (ExtractTask *)malloc( sizeof( ExtractTask ) * max<u64>( entryCount, 1 ) );
+	ExtractFileSet files = { .slots = incremental ? (ExtractFileSlot *)calloc( hashCapacity, sizeof( ExtractFileSlot ) ) : nullptr, .capacity = hashCapacity, .zip = zip, .map = map };
+
+	if ( !entries || !tasks || ( incremental && !files.slots ) )
+	{
+		log_error( "Failed to allocate memory for extraction." );
+
+		free( files.slots );
+		free( tasks );
+		free( entries );
+
+		return false;
+	}
+
+	// Each folder is made once, the files' folders are made here too so none are missing when the threads start
+	DirectoryCache folders;
+
+	if ( !directory_cache_begin( &folders, allocator, path, extract_folder_estimate( zip, map, entryCount ) ) )
+	{
+		log_error( "Failed to create folder: %s", path );
+		directory_cache_end( &folders );
+
+		free( files.slots );
+		free( tasks );
+		free( entries );
+
+		return false;
+	}
+
+	// What the last run wrote, the records are made again from what this archive has
+	SetupFileRecord previous[ PROJECT_SETUP_FILE_COUNT ];
+
+	for ( u64 s = 0; s < PROJECT_SETUP_FILE_COUNT; ++s )
+	{
+		previous[ s ] = setupFiles[ s ];
+		setupFiles[ s ] = {};
+	}
+
+	u8 setupBuffer[ KB( 4 ) ];
+	u64 fileCount = 0;
+	u64 keptCount = 0;
+	bool extracted = true;
+
+	for ( u64 i = 0; i < entryCount && extracted; ++i )
+	{
+		if ( !extract_entry_stat( zip, map, i, name, sizeof( name ), &size ) )
+		{
+			log_error( "Error getting file stat." );
+			extracted = false;
+			continue;
+		}
+
+		u64 skip = archive_root_skip( name, root, rootBytes );
+		const char *relative = name + skip;
+		u64 bytes = string_utf8_bytes( relative ) - 1;
+
+		// The root folder itself
+		if ( bytes == 0 )
+			continue;
+
+		bool file = relative[ bytes - 1 ] != '/';
+
+		if ( files.slots )
+			extract_file_insert( &files, relative, bytes, i, skip );
+
+		if ( fileList )
+			extract_file_list_add( fileList, relative, bytes );
+
+		SetupFileRecord *setup = nullptr;
+		u64 setupIndex = 0;
+
+		for ( ; file && setupIndex < PROJECT_SETUP_FILE_COUNT; ++setupIndex )
+		{
+			if ( string_utf8_compare( relative, PROJECT_SETUP_FILES[ setupIndex ] ) )
+			{
+				setup = &setupFiles[ setupIndex ];
+				break;
+			}
+		}
+
+		if ( setup )
+		{
+			setup->known = extract_entry_crc( zip, map, i, &setup->archiveCrc );
+			setup->archiveSize = size;
+		}
+
+		// A file's folder is the one it is in
+		if ( file )
+		{
+			while ( bytes > 0 && relative[ bytes - 1 ] != '/' )
+				--bytes;
+		}
+
+		// Folder, without its trailing separator
+		bytes = bytes > 0 ? bytes - 1 : 0;
+
+		const DirectoryCacheEntry *folder = nullptr;
+		bool made = extract_make_folder( &folders, path, relative, bytes, &folder );
+
+		if ( !made )
+		{
+			log_error( "Failed to create folder: %s%.*s", path, (i32)bytes, relative );
+			extracted = false;
+		}
+		else if ( file )
+		{
+			const SetupFileRecord *last = setup ? &previous[ setupIndex ] : nullptr;
+
+			// Written from this same entry with the same placeholders, the file there is checked against what was written
+			if ( incremental && setup && setup->known && last->known && last->archiveCrc == setup->archiveCrc && last->archiveSize == setup->archiveSize &&
+				extract_unchanged( path, folder, relative, last->writtenSize, last->writtenCrc, setupBuffer, sizeof( setupBuffer ) ) )
+			{
+				setup->kept = true;
+				setup->writtenCrc = last->writtenCrc;
+				setup->writtenSize = last->writtenSize;
+				keptCount += 1;
+			}
+			else
+			{
+				// File, inflating and writing both scale with the size written
+				entries[ fileCount++ ] = { .index = i, .cost = EXTRACT_FILE_COST + size, .folder = folder, .skip = skip };
+			}
+		}
+	}
+
+	if ( extracted )
+	{
+		ExtractJob job = { .source = source, .path = path, .map = map, .libzip = zip != nullptr, .incremental = incremental, .entries = entries, .tasks = tasks, .taskCount = 0, .next = 0, .failed = 0, .unchanged = 0, .workers = {} };
+		job.taskCount = extract_schedule( entries, fileCount, tasks );
+
+		// A thread is only worth starting for a handful of files
+		u64 threadCount = min<u64>( min<u64>( threads, max<u64>( fileCount / EXTRACT_MIN_FILES_PER_THREAD, 1 ) ), max<u64>( job.taskCount, 1 ) );
+		u64 buffers = 0;
+
+		// Each thread inflates into its own buffer, there are only as many threads as buffers that fit
+		for ( ; buffers < threadCount; ++buffers )
+		{
+			job.workers[ buffers ].buffer = allocator->allocate<u8>( EXTRACT_CHUNK_SIZE );
+
+			if ( !job.workers[ buffers ].buffer )
+				break;
+		}
+
+		if ( buffers == 0 )
+		{
+			log_error( "Failed to allocate memory for extraction." );
+			directory_cache_end( &folders );
+
+			free( files.slots );
+			free( tasks );
+			free( entries );
+
+			return false;
+		}
+
+		// Each thread has its own ring, set up here and used by the thread it goes to
+		if ( options.ioBackend == IO_BACKEND_URING )
+		{
+			u64 rings = 0;
+
+			for ( ; rings < buffers; ++rings )
+			{
+				ExtractWorker *worker = &job.workers[ rings ];
+				worker->uringBuffer = allocator->allocate<u8>( EXTRACT_CHUNK_SIZE );
+
+				if ( !worker->uringBuffer || !uring_writer_begin( &worker->uring, worker->uringBuffer, EXTRACT_CHUNK_SIZE, options.durability == DURABILITY_FILE ) )
+					break;
+
+				worker->uringActive = true;
+			}
+
+			if ( rings < buffers )
+				log_error( "io_uring is not available for every thread, %llu of %llu write with stdio.", (unsigned long long)( buffers - rings ), (unsigned long long)buffers );
+		}
+
+		std::thread workers[ MAX_THREADS ];
+		u64 started = 0;
+
+		for ( ; started + 1 < buffers; ++started )
+			workers[ started ] = std::thread( extract_files_worker, &job, started + 1 );
+
+		extract_files( &job, zip, 0 );
+
+		for ( u64 i = 0; i < started; ++i )
+			workers[ i ].join();
+
+		for ( u64 i = 0; i < buffers; ++i )
+		{
+			if ( job.workers[ i ].inflaterActive )
+				inflateEnd( &job.workers[ i ].inflater );
+		}
+
+		// Reverse order of allocation so the bump allocator can rewind
+		for ( u64 i = buffers; i-- > 0; )
+		{
+			if ( job.workers[ i ].uringBuffer )
+			{
+				uring_writer_end( &job.workers[ i ].uring );
+				allocator->free( job.workers[ i ].uringBuffer );
+			}
+		}
+
+		for ( u64 i = buffers; i-- > 0; )
+			allocator->free( job.workers[ i ].buffer );
+
+		*stats = { .files = fileCount + keptCount, .tasks = job.taskCount, .threads = started + 1, .wallUs = time_now_us() - wallStart, .workUs = 0, .criticalPathUs = 0, .busiestThreadUs = 0,
+			.unchanged = job.unchanged + keptCount, .removed = 0 };
+
+		// Tasks are independent, the longest one is the critical path no number of threads gets under
+		for ( u64 i = 0; i <= started; ++i )
+		{
+			stats->workUs += job.workers[ i ].busyUs;
+			stats->criticalPathUs = max( stats->criticalPathUs, job.workers[ i ].longestTaskUs );
+			stats->busiestThreadUs = max( stats->busiestThreadUs, job.workers[ i ].busyUs );
+		}
+
+		log( "Extracted %llu files as %llu tasks on %llu threads in %llu us: critical path %llu us, busiest thread %llu us, total work %llu us.",
+			(unsigned long long)stats->files, (unsigned long long)stats->tasks, (unsigned long long)stats->threads, (unsigned long long)stats->wallUs,
+			(unsigned long long)stats->criticalPathUs, (unsigned long long)stats->busiestThreadUs, (unsigned long long)stats->workUs );
+
+		if ( job.failed > 0 )
+		{
+			log_error( "%llu of %llu files failed to extract.", (unsigned long long)job.failed.load(), (unsigned long long)fileCount );
+			extracted = false;
+		}
+
+		// Only once everything is in place, a failed update removes nothing
+		if ( extracted && incremental )
+		{
+			stats->removed = extract_remove_stale( path, &files );
+
+			log( "Updated in place: %llu of %llu files unchanged, %llu removed.", (unsigned long long)stats->unchanged, (unsigned long long)stats->files, (unsigned long long)stats->removed );
+		}
+	}
+
+	directory_cache_end( &folders );
+
+	free( files.slots );
+	free( tasks );
+	free( entries );
+
+	return extracted;
+}
+
+// Replaces every placeholder in a file in one pass, the file is only written again when one is found.
+// What a placeholder is replaced with is not searched again.
+static void replace_placeholders_in_file( const char *folder, Allocator *allocator, const char *file, const Substitute *substitute )
+{
+	char filePath[ MAX_FILEPATH ];
+
+	string_utf8_copy( filePath, folder );
+	string_utf8_append( filePath, file );
+
+	// Read the file into memory
+	FILE *fp = fopen( filePath, "rb" );
+	if ( !fp )
+	{
+		log_error( "Failed to open file for reading: %s", filePath );
+		return;
+	}
+
+	fseek( fp, 0, SEEK_END );
+	u64 fileSize = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+
+	u8 *data = fileSize > 0 ? allocator->allocate<u8>( fileSize ) : nullptr;
+	u64 read = data ? fread( data, 1, fileSize, fp ) : 0;
+
+	fclose( fp );
+
+	if ( read != fileSize || ( fileSize > 0 && !data ) )
+	{
+		log_error( "Failed to read file fully: %s ( %llu / %llu )", filePath, (unsigned long long)read, (unsigned long long)fileSize );
+
+		if ( data )
+			allocator->free( data );
+
+		return;
+	}
+
+	u64 offset = 0;
+	SubstituteMatch match;
+
+	if ( !data || !substitute_next( substitute, data, fileSize, &offset, &match ) )
+	{
+		if ( data )
+			allocator->free( data );
+
+		return;
+	}
+
+	// Writing the updated data back to file, the text between placeholders straight from what was read
+	fp = fopen( filePath, "wb" );
+	if ( !fp )
+	{
+		log_error( "Failed to open file for writing: %s", file );
+		allocator->free( data );
+		return;
+	}
+
+	u64 copied = 0;
+	bool written = true;
+
+	do
+	{
+		written = fwrite( data + copied, 1, match.start - copied, fp ) == match.start - copied &&
+			fwrite( match.pattern->replace, 1, match.pattern->replaceBytes, fp ) == match.pattern->replaceBytes;
+
+		copied = offset;
+	}
+	while ( written && substitute_next( substitute, data, fileSize, &offset, &match ) );
+
+	written = written && fwrite( data + copied, 1, fileSize - copied, fp ) == fileSize - copied;
+
+	if ( !close_file( fp, options.durability == DURABILITY_FILE ) || !written )
+		log_error( "Failed to write file: %s", file );
+
+	allocator->free( data );
+}
+
+// A repo written as user/project becomes its GitHub archive, a full url is used as is
+// @return the format of the archive, a full url ending in .tar.gz or .tgz is a tarball
+static SOURCE_FORMAT source_url( char *url, u64 maxUrl, const char *source )
+{
+	if ( strncmp( source, "http://", 7 ) == 0 || strncmp( source, "https://", 8 ) == 0 )
+	{
+		string_utf8_copy( url, maxUrl, source );
+
+		u64 length = string_utf8_bytes( url ) - 1;
+
+		if ( ( length > 7 && string_utf8_compare( url + length - 7, ".tar.gz" ) ) || ( length > 4 && string_utf8_compare( url + length - 4, ".tgz" ) ) )
+			return SOURCE_FORMAT_TAR_GZ;
+
+		if ( length > 4 && string_utf8_compare( url + length - 4, ".zip" ) )
+			return SOURCE_FORMAT_ZIP;
+
+		return options.format;
+	}
+
+	string_utf8_copy( url, maxUrl, "https://github.com/" );
+	string_utf8_append( url, maxUrl, source );
+	string_utf8_append( url, maxUrl, "/archive/master" );
+	string_utf8_append( url, maxUrl, SOURCE_FORMAT_EXTENSION[ options.format ] );
+
+	return options.format;
+}
+
+static bool memory_arena_create( MemoryArena *arena, u64 permanentSize, u64 transientSize, u64 fastBumpSize )
+{
+	*arena =
+	{
+		.flags = 0,
+		.memory = nullptr,
+		.permanent =
+		{
+			.capacity = 0,
+			.available = 0,
+			.memory = nullptr,
+			.lastAlloc = nullptr,
+			.allocate_func = memory_bump_allocate,
+			.reallocate_func = memory_bump_reallocate,
+			.shrink_func = memory_bump_shrink,
+			.free_func = memory_bump_free,
+			.attach_func = memory_bump_attach,
+		},
+		.transient =
+		{
+			.capacity = 0,
+			.available = 0,
+			.memory = nullptr,
+			.lastAlloc = nullptr,
+			.allocate_func = memory_bump_allocate,
+			.reallocate_func = memory_bump_reallocate,
+			.shrink_func = memory_bump_shrink,
+			.free_func = memory_bump_free,
+			.attach_func = memory_bump_attach,
+		},
+		.fastBump =
+		{
+			.capacity = 0,
+			.available = 0,
+			.memory = nullptr,
+			.lastAlloc = nullptr,
+			.allocate_func = memory_fast_bump_allocate,
+			.reallocate_func = nullptr,
+			.shrink_func = nullptr,
+			.free_func = nullptr,
+			.attach_func = nullptr,
+		},
+	};
+
+	// Not cleared, with -memory that would touch every page reserved for the archive
+	return arena->init( permanentSize, transientSize, fastBumpSize, false );
+}
+
+// Adds a project, sharing the source of an earlier project with the same url
+static RESULT_CODE add_project( const char *name, const char *destFolder, const char *sourceRepo )
+{
+	if ( app.projectCount >= app.maxProjects )
+		return RESULT_CODE_FAILED_TO_PARSE_MANIFEST;
+
+	Project *project = &app.projects[ app.projectCount ];
+	*project = {};
+
+	string_utf8_copy( project->name, name );
+	string_utf8_copy( project->destFolder, destFolder );
+
+	char last = project->destFolder[ string_utf8_bytes( project->destFolder ) - 2 ];
+	if ( last != '\\' && last != '/' )
+	{
+		string_utf8_append( project->destFolder, "/" );
+	}
+
+	string_utf8_copy( project->finalProjectFolder, project->destFolder );
+	string_utf8_append( project->finalProjectFolder, project->name );
+	string_utf8_append( project->finalProjectFolder, "/" );
+
+	// Extracted next to the final folder, so the rename never crosses a filesystem
+	string_utf8_copy( project->stagingFolder, project->destFolder );
+	string_utf8_append( project->stagingFolder, project->name );
+	string_utf8_append( project->stagingFolder, PROJECT_STAGING_SUFFIX );
+
+	char url[ MAX_FILEPATH ];
+	SOURCE_FORMAT format = source_url( url, sizeof( url ), sourceRepo );
+
+	for ( u64 i = 0; i < app.sourceCount && !project->source; ++i )
+	{
+		if ( string_utf8_compare( app.sources[ i ].url, url ) )
+			project->source = &app.sources[ i ];
+	}
+
+	if ( !project->source )
+	{
+		Source *source = &app.sources[ app.sourceCount ];
+		*source = {};
+
+		string_utf8_copy( source->url, url );
+		source->format = format;
+
+		if ( app.sourceCount == 0 )
+			string_utf8_format( source->archivePath, "%s%s", TEMP_ARCHIVE_FILE, SOURCE_FORMAT_EXTENSION[ format ] );
+		else
+			string_utf8_format( source->archivePath, "%s.%llu%s", TEMP_ARCHIVE_FILE, (unsigned long long)app.sourceCount, SOURCE_FORMAT_EXTENSION[ format ] );
+
+		source->archive = { .allocator = &app.memoryArena.permanent };
+
+		// The first project made from a source puts its tree in the cache
+		project->storeTree = true;
+		project->source = source;
+		app.sourceCount += 1;
+	}
+
+	// The tombstones left in each folder are looked for once, by the first project made there
+	project->scanFolder = true;
+
+	for ( u64 i = 0; i < app.projectCount && project->scanFolder; ++i )
+		project->scanFolder = !string_utf8_compare( app.projects[ i ].destFolder, project->destFolder );
+
+	// Projects going to the same folder are made in order on one thread, they extract to the same place
+	project->group = app.projectCount;
+
+	for ( u64 i = 0; i < app.projectCount; ++i )
+	{
+		if ( string_utf8_compare( app.projects[ i ].finalProjectFolder, project->finalProjectFolder ) )
+		{
+			project->group = app.projects[ i ].group;
+			break;
+		}
+	}
+
+	app.projectCount += 1;
+
+	return RESULT_CODE_SUCCESS;
+}
+
+// Upper bound on the projects in a manifest, one per line, so memory can be reserved before reading it
+static u64 manifest_count( const char *path, u64 *bytes )
+{
+	FILE *file = fopen( path, "rb" );
+	if ( !file )
+		return 0;
+
+	u64 lines = 1;
+	*bytes = 0;
+	i32 c;
+
+	while ( ( c = fgetc( file ) ) != EOF )
+	{
+		*bytes += 1;
+
+		if ( c == '\n' )
+			lines += 1;
+	}
+
+	fclose( file );
+
+	return lines;
+}
+
+// Splits FIND=REPLACE in place into the next of the variables
+// @return false if it isn't a pair, or there are already MAX_VARIABLES
+static bool variable_add( Variable *variables, u64 *variableCount, char *pair )
+{
+	char *separator = strchr( pair, '=' );
+
+	if ( !separator || separator == pair || *variableCount >= MAX_VARIABLES )
+		return false;
+
+	*separator = '\0';
+
+	variables[ ( *variableCount )++ ] = { .find = pair, .replace = separator + 1 };
+
+	return true;
+}
+
+// Bytes the -var pairs and the -vars file take once copied into memory
+// @return false if the file can't be opened
+static bool variables_bytes( u64 *bytes )
+{
+	*bytes = 0;
+
+	for ( u64 i = 0; i < options.variableArgCount; ++i )
+		*bytes += string_utf8_bytes( options.variableArgs[ i ] );
+
+	if ( options.variablesFile[ 0 ] == '\0' )
+		return true;
+
+	FILE *file = fopen( options.variablesFile, "rb" );
+	if ( !file )
+		return false;
+
+	fseek( file, 0, SEEK_END );
+	*bytes += ftell( file );
+	fclose( file );
+
+	return true;
+}
+
+// The pairs given to every project, one per line of the -vars file then those of -var, which win where they share a FIND.
+// A line is FIND=REPLACE up to its end, so a replacement can hold spaces. Blank lines and lines starting with # are skipped.
+static RESULT_CODE variables_parse( u64 bytes )
+{
+	char *text = app.memoryArena.permanent.allocate<char>( bytes + 1 );
+	if ( !text )
+		return RESULT_CODE_FAILED_TO_ALLOCATE_HEAP_MEMORY;
+
+	u64 argBytes = 0;
+
+	for ( u64 i = 0; i < options.variableArgCount; ++i )
+		argBytes += string_utf8_bytes( options.variableArgs[ i ] );
+
+	u64 fileBytes = bytes - argBytes;
+	text[ fileBytes ] = '\0';
+
+	if ( options.variablesFile[ 0 ] != '\0' )
+	{
+		FILE *file = fopen( options.variablesFile, "rb" );
+		if ( !file )
+			return RESULT_CODE_FAILED_TO_OPEN_FILE;
+
+		u64 read = fread( text, 1, fileBytes, file );
+		fclose( file );
+
+		if ( read != fileBytes )
+			return RESULT_CODE_FAILED_TO_OPEN_FILE;
+	}
+
+	char *line = text;
+	u64 lineNumber = 0;
+
+	while ( line && *line )
+	{
+		char *next = strchr( line, '\n' );
+		if ( next )
+			*next++ = '\0';
+
+		lineNumber += 1;
+
+		u64 lineBytes = string_utf8_bytes( line ) - 1;
+		while ( lineBytes > 0 && line[ lineBytes - 1 ] == '\r' )
+			line[ --lineBytes ] = '\0';
+
+		while ( *line == ' ' || *line == '\t' )
+			++line;
+
+		if ( *line != '\0' && *line != '#' && !variable_add( app.variables, &app.variableCount, line ) )
+		{
+			log_error( "Variables %s:%llu: expected FIND=REPLACE, at most %lld of them", options.variablesFile, (unsigned long long)lineNumber, (long long)MAX_VARIABLES );
+			return RESULT_CODE_FAILED_TO_PARSE_VARIABLES;
+		}
+
+		line = next;
+	}
+
+	// After the file's terminator
+	char *pair = text + fileBytes + 1;
+
+	for ( u64 i = 0; i < options.variableArgCount; ++i )
+	{
+		u64 pairBytes = string_utf8_bytes( options.variableArgs[ i ] );
+		string_utf8_copy( pair, pairBytes, options.variableArgs[ i ] );
+
+		if ( !variable_add( app.variables, &app.variableCount, pair ) )
+		{
+			log_error( "Variable '%s' should be FIND=REPLACE, at most %lld of them", options.variableArgs[ i ], (long long)MAX_VARIABLES );
+			return RESULT_CODE_FAILED_TO_PARSE_VARIABLES;
+		}
+
+		pair += pairBytes;
+	}
+
+	return RESULT_CODE_SUCCESS;
+}
+
+// Each line is: <project> <dest-folder> <source> [FIND=REPLACE ...]
+// Blank lines and lines starting with # are skipped
+static RESULT_CODE manifest_parse( const char *path, u64 bytes )
+{
+	char *text = app.memoryArena.permanent.allocate<char>( bytes + 1 );
+	if ( !text )
+		return RESULT_CODE_FAILED_TO_ALLOCATE_HEAP_MEMORY;
+
+	FILE *file = fopen( path, "rb" );
+	if ( !file )
+		return RESULT_CODE_FAILED_TO_OPEN_FILE;
+
+	u64 read = fread( text, 1, bytes, file );
+	fclose( file );
+
+	if ( read != bytes )
+		return RESULT_CODE_FAILED_TO_OPEN_FILE;
+
+	text[ bytes ] = '\0';
+
+	char *line = text;
+	u64 lineNumber = 0;
+
+	while ( line && *line )
+	{
+		char *next = strchr( line, '\n' );
+		if ( next )
+			*next++ = '\0';
+
+		lineNumber += 1;
+
+		char *tokens[ 3 + MAX_VARIABLES ];
+		u64 tokenCount = 0;
+		const char *token;
+
+		char *remaining = string_utf8_tokenise( line, " \t\r", &token );
+
+		while ( token && tokenCount < sizeof( tokens ) / sizeof( tokens[ 0 ] ) )
+		{
+			tokens[ tokenCount++ ] = (char *)token;
+			remaining = string_utf8_tokenise( remaining, " \t\r", &token );
+		}
+
+		line = next;
+
+		if ( tokenCount == 0 || tokens[ 0 ][ 0 ] == '#' )
+			continue;
+
+		if ( tokenCount < 3 || token )
+		{
+			log_error( "Manifest %s:%llu: expected <project> <dest-folder> <source> [FIND=REPLACE ...]", path, (unsigned long long)lineNumber );
+			return RESULT_CODE_FAILED_TO_PARSE_MANIFEST;
+		}
+
+		RESULT_CODE result = add_project( tokens[ 0 ], tokens[ 1 ], tokens[ 2 ] );
+		if ( result != RESULT_CODE_SUCCESS )
+			return result;
+
+		Project *project = &app.projects[ app.projectCount - 1 ];
+
+		for ( u64 i = 3; i < tokenCount; ++i )
+		{
+			if ( !variable_add( project->variables, &project->variableCount, tokens[ i ] ) )
+			{
+				log_error( "Manifest %s:%llu: variable '%s' should be FIND=REPLACE", path, (unsigned long long)lineNumber, tokens[ i ] );
+				return RESULT_CODE_FAILED_TO_PARSE_MANIFEST;
+			}
+		}
+	}
+
+	return RESULT_CODE_SUCCESS;
+}
+
+// Downloads a source's archive, or confirms the cached one is current
+// With streamProject the archive is extracted into that project as it arrives
+static RESULT_CODE fetch_source( CURL *handle, Source *source, Project *streamProject )
+{
+	CURLcode res = CURLE_OK;
+	char curlErrorString[ CURL_ERROR_SIZE ] = "";
+	char rangeUrl[ MAX_FILEPATH ];
+	u64 rangeLength = 0;
+	DownloadRanges ranges = {};
+	bool restart = true;
+	DownloadValidators resumeValidators = {};
+	Array<DownloadAttempt, DOWNLOAD_MAX_ATTEMPTS + 1> &attempts = source->attempts;
+	curl_slist *conditionalHeaders = nullptr;
+	StreamTarget streamTarget = { .format = source->format, .zipStream = {}, .tarStream = {}, .cacheFile = nullptr, .cacheFailed = false };
+	ArchiveCacheEntry *cached = &source->cached;
+	bool stream = streamProject != nullptr;
+
+	// A cached archive is only downloaded again if the server says it changed
+	if ( options.cacheFolder[ 0 ] != '\0' && archive_cache_lookup( options.cacheFolder, source->url, SOURCE_FORMAT_EXTENSION[ source->format ], cached ) )
+	{
+		log( "Revalidating cached archive %s.", cached->archivePath );
+		conditionalHeaders = archive_cache_conditional_headers( cached );
+	}
+
+	// Parallel ranged download, if the server supports it
+	if ( options.connections > 1 )
+	{
+		if ( stream )
+			log( "-connections is ignored with -stream, the archive has to arrive in order." );
+		else
+		{
+			long probeResponseCode = 0;
+			rangeLength = download_probe_ranges( source->url, rangeUrl, sizeof( rangeUrl ), &options.retry, conditionalHeaders, &source->validators, &probeResponseCode );
+			source->cacheHit = conditionalHeaders && probeResponseCode == 304;
+		}
+
+		if ( rangeLength )
+			log( "Downloading %llu bytes over up to %d connections.", (unsigned long long)rangeLength, options.connections );
+		else if ( !source->cacheHit )
+			log( "Archive can't be downloaded in ranges, using one connection." );
+	}
+
+	download_apply_policy( handle, &options.retry );
+
+	RESULT_CODE result = RESULT_CODE_SUCCESS;
+
+	// Throughput is only sampled when it will be reported
+	curl_easy_setopt( handle, CURLOPT_NOPROGRESS, options.stats == STATS_FORMAT_NONE ? 1 : 0 );
+	curl_easy_setopt( handle, CURLOPT_XFERINFOFUNCTION, download_progress_callback );
+	curl_easy_setopt( handle, CURLOPT_XFERINFODATA, &source->progress );
+
+	for ( ; !source->cacheHit; )
+	{
+		u64 attemptStart = time_now_ms();
+		long responseCode = 0;
+		u64 retryAfterMs = 0;
+		DownloadTimings timings = {};
+
+		if ( rangeLength )
+		{
+			res = download_ranged( rangeUrl, rangeLength, options.connections, &ranges, options.inMemory ? &source->archive : nullptr, source->archivePath, &options.retry,
+				&source->validators, &responseCode, &timings, &source->progress, curlErrorString );
+
+			// The archive changed since the ranges were sized from it, or ranges aren't served after all, start over on one connection
+			if ( res == CURLE_RANGE_ERROR && responseCode == 200 )
+			{
+				log( "Archive changed or can't be fetched in ranges, restarting it over one connection." );
+				rangeLength = 0;
+				restart = true;
+			}
+		}
+		else
+		{
+			// Retries continue from what was already received, unless that can't be used
+			FILE *file = nullptr;
+			u64 resumeFrom = 0;
+
+			if ( stream )
+			{
+				if ( restart || stream_target_failed( &streamTarget ) )
+				{
+					stream_target_free( &streamTarget );
+
+					// Starts over in an empty folder, whatever an earlier attempt or run left there is removed
+					delete_directory( streamProject->stagingFolder );
+
+					if ( !stream_target_begin( &streamTarget, &app.memoryArena.transient, streamProject->stagingFolder ) )
+					{
+						result = RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE;
+						break;
+					}
+				}
+
+				resumeFrom = stream_target_bytes_in( &streamTarget );
+
+				if ( options.cacheFolder[ 0 ] != '\0' && !streamTarget.cacheFailed )
+				{
+					streamTarget.cacheFile = fopen( cached->partPath, resumeFrom ? "ab" : "wb" );
+					streamTarget.cacheFailed = !streamTarget.cacheFile;
+				}
+			}
+			else if ( options.inMemory )
+			{
+				if ( restart )
+					source->archive.clear();
+
+				resumeFrom = source->archive.size;
+			}
+			else
+			{
+				file = fopen( source->archivePath, restart ? "wb" : "ab" );
+				if ( !file )
+				{
+					log_error( "Failed to open the file: %s.", source->archivePath );
+					result = RESULT_CODE_FAILED_TO_OPEN_FILE;
+					break;
+				}
+
+				fseek( file, 0, SEEK_END );
+				resumeFrom = ftell( file );
+			}
+
+			if ( resumeFrom )
+				log( "Resuming download from %llu bytes.", (unsigned long long)resumeFrom );
+
+			// A resume only continues the version already received, a changed archive comes back whole with 200 and fails the resume
+			curl_slist *ifRange = resumeFrom ? download_if_range( &resumeValidators ) : nullptr;
+
+			// curl fails with CURLE_RANGE_ERROR, before writing anything, if the server does not honour the offset
+			curl_easy_setopt( handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)resumeFrom );
+			curl_easy_setopt( handle, CURLOPT_URL, source->url );
+			curl_easy_setopt( handle, CURLOPT_VERBOSE, 0 );
+			curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, 1 );
+			curl_easy_setopt( handle, CURLOPT_ERRORBUFFER, curlErrorString );
+			curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, download_validators_header );
+			curl_easy_setopt( handle, CURLOPT_HEADERDATA, &source->validators );
+
+			// Once any of a changed archive has arrived the rest is fetched only if it is still the same version
+			curl_easy_setopt( handle, CURLOPT_HTTPHEADER, resumeFrom ? ifRange : conditionalHeaders );
+
+			if ( stream )
+			{
+				curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, write_data_stream );
+				curl_easy_setopt( handle, CURLOPT_WRITEDATA, &streamTarget );
+			}
+			else if ( options.inMemory )
+			{
+				curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, write_data_memory );
+				curl_easy_setopt( handle, CURLOPT_WRITEDATA, &source->archive );
+			}
+			else
+			{
+				curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, write_data );
+				curl_easy_setopt( handle, CURLOPT_WRITEDATA, file );
+			}
+
+			res = curl_easy_perform( handle );
+
+			curl_easy_setopt( handle, CURLOPT_HTTPHEADER, nullptr );
+			curl_slist_free_all( ifRange );
+
+			curl_easy_getinfo( handle, CURLINFO_RESPONSE_CODE, &responseCode );
+			download_collect_timings( handle, &timings );
+
+			#if LIBCURL_VERSION_NUM >= 0x074200
+				curl_off_t retryAfter = 0;
+				if ( curl_easy_getinfo( handle, CURLINFO_RETRY_AFTER, &retryAfter ) == CURLE_OK && retryAfter > 0 )
+					retryAfterMs = static_cast<u64>( retryAfter ) * 1000;
+			#endif
+
+			if ( file )
+				fclose( file );
+
+			if ( streamTarget.cacheFile )
+			{
+				fclose( streamTarget.cacheFile );
+				streamTarget.cacheFile = nullptr;
+			}
+
+			source->cacheHit = conditionalHeaders && responseCode == 304 && resumeFrom == 0;
+
+			// What a fresh start was served as, the version a resume has to match
+			if ( resumeFrom == 0 )
+				resumeValidators = source->validators;
+
+			// A resume past the end of the archive is refused with 416, and a changed archive with 200, start over
+			restart = ( res == CURLE_RANGE_ERROR || responseCode == 416 );
+
+			if ( restart )
+				log( "Server can't resume the download, restarting it." );
+
+			// Without a validator a resume could join two versions of the archive
+			if ( !restart && !download_validators_usable( &resumeValidators ) )
+				restart = true;
+		}
+
+		DownloadAttempt attempt =
+		{
+			.result = res,
+			.responseCode = responseCode,
+			.errorClass = download_classify( res, responseCode ),
+			.durationMs = time_now_ms() - attemptStart,
+			.delayMs = 0,
+			.timings = timings,
+		};
+
+		if ( attempt.errorClass != DOWNLOAD_ERROR_RETRYABLE || attempts.count >= (u64)options.attempts )
+		{
+			attempts.add( attempt );
+			break;
+		}
+
+		attempt.delayMs = download_backoff_delay( &options.retry, static_cast<i32>( attempts.count ), retryAfterMs );
+		attempts.add( attempt );
+
+		log( "Attempt %llu failed after %llu ms: %s ( HTTP %ld ), retrying in %llu ms.", (unsigned long long)attempts.count,
+			(unsigned long long)attempt.durationMs, curlErrorString[ 0 ] ? curlErrorString : curl_easy_strerror( res ), responseCode, (unsigned long long)attempt.delayMs );
+
+		sleep_ms( attempt.delayMs );
+	}
+
+	curl_slist_free_all( conditionalHeaders );
+
+	// Stop the handle pointing at this function's error buffer
+	curl_easy_setopt( handle, CURLOPT_ERRORBUFFER, nullptr );
+
+	for ( u64 i = 0; i < attempts.count; ++i )
+	{
+		const DownloadAttempt &attempt = attempts.data[ i ];
+		log( "Attempt %llu: %s, HTTP %ld, %llu ms, %llu bytes at %llu bytes/s.", (unsigned long long)( i + 1 ), curl_easy_strerror( attempt.result ), attempt.responseCode,
+			(unsigned long long)attempt.durationMs, (unsigned long long)attempt.timings.bytes, (unsigned long long)attempt.timings.bytesPerSecond );
+	}
+
+	// With a cached archive the stream received nothing, the project is made from the cache instead.
+	// Its end is checked once the whole archive came, then it is freed here for every path below.
+	bool streamed = stream && !source->cacheHit && result == RESULT_CODE_SUCCESS && res == CURLE_OK;
+	bool verified = false;
+
+	if ( streamed )
+	{
+		verified = stream_target_end( &streamTarget );
+		const char *comment = stream_target_comment( &streamTarget );
+
+		if ( options.cacheFolder[ 0 ] != '\0' )
+			tree_cache_commit_id( comment, string_utf8_bytes( comment ) - 1, source->commitId );
+	}
+
+	stream_target_free( &streamTarget );
+
+	if ( result != RESULT_CODE_SUCCESS )
+		return result;
+
+	if ( res != CURLE_OK )
+	{
+		log_error( "A problem has occured downloading %s.", source->url );
+		log_error( "Error: %s", curlErrorString[ 0 ] ? curlErrorString : curl_easy_strerror( res ) );
+
+		if ( attempts.data[ attempts.count - 1 ].errorClass == DOWNLOAD_ERROR_FATAL )
+			log_error( "The error is not one a retry can fix, gave up after %llu attempt(s).", (unsigned long long)attempts.count );
+
+		return RESULT_CODE_FAILED_TO_RETRIEVE_DATA;
+	}
+
+	if ( source->cacheHit )
+		log( "Cached archive is up to date." );
+	else
+		log( "Archive downloaded." );
+
+	if ( streamed )
+	{
+		if ( !verified )
+		{
+			log_error( "Error unzipping archive." );
+			return RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE;
+		}
+
+		source->streamed = true;
+
+		if ( options.cacheFolder[ 0 ] != '\0' && !streamTarget.cacheFailed && ( source->validators.etag[ 0 ] || source->validators.lastModified[ 0 ] ) )
+			archive_cache_store_file( cached, cached->partPath, &source->validators );
+		else if ( options.cacheFolder[ 0 ] != '\0' )
+			remove( cached->partPath );
+	}
+	else if ( stream )
+	{
+		// Opened for the response that turned out to be a 304
+		remove( cached->partPath );
+	}
+
+	return RESULT_CODE_SUCCESS;
+}
+
+// Runs a tar.gz source through a TarStream, from memory, the cache or the downloaded file
+// Without a path only the headers up to the first entry are read, for the comment
+static bool read_source_tar_gz( Source *source, TarStream *ts, Allocator *allocator, const char *path )
+{
+	if ( !tar_stream_begin( ts, allocator, path ) )
+		return false;
+
+	ts->syncFiles = options.durability == DURABILITY_FILE;
+
+	bool probe = path == nullptr;
+	bool read = true;
+
+	if ( options.inMemory && !source->cacheHit )
+	{
+		for ( u64 offset = 0; read && offset < source->archive.size && !( probe && ts->entryCount ); offset += TAR_STREAM_OUTPUT_SIZE )
+			read = tar_stream_write( ts, source->archive.data + offset, min( (u64)TAR_STREAM_OUTPUT_SIZE, source->archive.size - offset ) );
+	}
+	else
+	{
+		const char *archivePath = source->cacheHit ? source->cached.archivePath : source->archivePath;
+
+		FILE *file = fopen( archivePath, "rb" );
+		if ( !file )
+		{
+			log_error( "Cannot open archive '%s'", archivePath );
+			return false;
+		}
+
+		u8 *chunk = allocator->allocate<u8>( TAR_STREAM_OUTPUT_SIZE );
+		u64 bytes;
+
+		read = chunk != nullptr;
+
+		while ( read && !( probe && ts->entryCount ) && ( bytes = fread( chunk, 1, TAR_STREAM_OUTPUT_SIZE, file ) ) > 0 )
+			read = tar_stream_write( ts, chunk, bytes );
+
+		fclose( file );
+
+		if ( chunk )
+			allocator->free( chunk );
+	}
+
+	return read && ( probe || tar_stream_end( ts ) );
+}
+
+// Copies the cached tree of a commit into the project in place of extracting the archive
+static bool instantiate_cached_tree( Project *project, const char *commitId )
+{
+	log( "Using the extracted tree of commit %s.", commitId );
+
+	TreeCacheLinks links;
+
+	if ( tree_cache_instantiate( options.cacheFolder, commitId, project->stagingFolder, options.treeLink, PROJECT_SETUP_FILES, PROJECT_SETUP_FILE_COUNT, &links ) )
+	{
+		log( "%llu files sharing the cached blocks, %llu linked, %llu copied.", (unsigned long long)links.shared, (unsigned long long)links.linked, (unsigned long long)links.copied );
+		return true;
+	}
+
+	log_error( "Failed to copy the cached tree of commit %s, extracting the archive.", commitId );
+	delete_directory( project->stagingFolder );
+
+	return false;
+}
+
+// Moves a project being replaced out of the way in one rename, tombstoneFolder is left empty when nothing was moved
+static void retire_project_folder( Project *project )
+{
+	string_utf8_format( project->tombstoneFolder, "%s%s%s%llx.%llx", project->destFolder, project->name, PROJECT_TOMBSTONE_SUFFIX,
+		(unsigned long long)app.processId, (unsigned long long)time_wall_us() );
+
+	if ( rename( project->finalProjectFolder, project->tombstoneFolder ) == 0 )
+		return;
+
+	project->tombstoneFolder[ 0 ] = '\0';
+
+	// Nothing to replace, or it can't be moved and is removed here instead
+	if ( errno != ENOENT )
+		delete_directory( project->finalProjectFolder );
+}
+
+// Queues the tombstone of the project replaced to be removed on another thread, once the new one is in place
+static void bury_project_folder( const Project *project )
+{
+	if ( project->tombstoneFolder[ 0 ] == '\0' )
+		return;
+
+	std::lock_guard<std::mutex> lock( app.tombstoneMutex );
+	app.tombstones[ app.tombstoneCount++ ] = static_cast<u64>( project - app.projects );
+	app.tombstoneQueued.notify_one();
+}
+
+// Whether a tombstone found in a folder was left by a run that ended before removing it. This run's may yet be put back
+// if their projects can't be renamed into place, and another run's are left to it while that run goes on.
+static bool tombstone_stale( const char *name )
+{
+	const char *suffix = strstr( name, PROJECT_TOMBSTONE_SUFFIX );
+	if ( !suffix )
+		return false;
+
+	const char *next = suffix + string_utf8_bytes( PROJECT_TOMBSTONE_SUFFIX ) - 1;
+	char *end = nullptr;
+
+	u64 id = strtoull( next, &end, 16 );
+	if ( end == next || *end != '.' )
+		return false;
+
+	next = end + 1;
+	u64 stamp = strtoull( next, &end, 16 );
+	if ( end == next || *end != '\0' )
+		return false;
+
+	if ( id == app.processId && stamp >= app.startWallUs )
+		return false;
+
+	// An id may be used again once its process has gone, a running one only keeps its tombstones for so long
+	return id == app.processId || !process_running( id ) || stamp + PROJECT_TOMBSTONE_MAX_AGE_US < app.startWallUs;
+}
+
+// Removes the tombstones of the projects replaced as they appear, and those of runs that ended before removing theirs
+static void remove_tombstones()
+{
+	for ( u64 i = 0; i < app.projectCount; ++i )
+	{
+		const Project *project = &app.projects[ i ];
+
+		if ( !project->scanFolder )
+			continue;
+
+		DIR *dir = opendir( project->destFolder );
+		if ( !dir )
+			continue;
+
+		struct dirent *entry;
+
+		while ( ( entry = readdir( dir ) ) != NULL )
+		{
+			if ( !tombstone_stale( entry->d_name ) )
+				continue;
+
+			char tombstone[ MAX_FILEPATH ];
+			string_utf8_format( tombstone, "%s%s", project->destFolder, entry->d_name );
+
+			u64 removed = 0;
+
+			if ( tree_remove( tombstone, 1, &removed ) )
+				log( "Removed %llu files and folders left in %s", (unsigned long long)removed, tombstone );
+		}
+
+		closedir( dir );
+	}
+
+	// One thread, so removing the old projects takes as little as it can from making the new ones
+	for ( u64 next = 0; ; ++next )
+	{
+		std::unique_lock<std::mutex> lock( app.tombstoneMutex );
+		app.tombstoneQueued.wait( lock, [ next ] { return next < app.tombstoneCount || app.projectsMade; } );
+
+		if ( next >= app.tombstoneCount )
+			return;
+
+		const Project *project = &app.projects[ app.tombstones[ next ] ];
+		lock.unlock();
+
+		u64 removed = 0;
+
+		if ( tree_remove( project->tombstoneFolder, 1, &removed ) )
+			log( "Removed %llu files and folders of the replaced %s", (unsigned long long)removed, project->finalProjectFolder );
+	}
+}
+
+// Hash of the placeholders and what they are replaced with, a record made with others doesn't describe the files written
+static u64 setup_substitution_hash( const Project *project )
+{
+	// FNV-1a, each string with its terminator so one can't run into the next
+	u64 hash = 0xcbf29ce484222325ull;
+
+	auto append = [ &hash ]( const char *text )
+	{
+		for ( const u8 *c = (const u8 *)text; ; ++c )
+		{
+			hash ^= *c;
+			hash *= 0x100000001b3ull;
+
+			if ( *c == '\0' )
+				break;
+		}
+	};
+
+	append( project->name );
+
+	for ( u64 i = 0; i < app.variableCount; ++i )
+	{
+		append( app.variables[ i ].find );
+		append( app.variables[ i ].replace );
+	}
+
+	for ( u64 i = 0; i < project->variableCount; ++i )
+	{
+		append( project->variables[ i ].find );
+		append( project->variables[ i ].replace );
+	}
+
+	return hash;
+}
+
+// Reads what the last run wrote for the setup files from the project's record, nothing is known when it used other placeholders.
+// The paths it lists are read when extracting, by extract_remove_stale.
+static void project_record_read( const char *folder, u64 substitutions, SetupFileRecord *records )
+{
+	char path[ MAX_FILEPATH ];
+	string_utf8_format( path, "%s%s", folder, PROJECT_RECORD_FILE );
+
+	FILE *file = fopen( path, "rb" );
+	if ( !file )
+		return;
+
+	char line[ MAX_FILEPATH + 8 ];
+	bool same = false;
+
+	while ( fgets( line, sizeof( line ), file ) )
+	{
+		char *value = line;
+		while ( *value && *value != ' ' )
+			++value;
+
+		if ( *value == '\0' )
+			continue;
+
+		*value++ = '\0';
+
+		const char *next = value;
+
+		if ( string_utf8_compare( line, "substitutions" ) )
+		{
+			same = convert_to_u64( value, &next ) == substitutions;
+			continue;
+		}
+
+		if ( !string_utf8_compare( line, "setup" ) )
+			continue;
+
+		char *name = value;
+		while ( *value && *value != ' ' )
+			++value;
+
+		if ( *value == '\0' )
+			continue;
+
+		*value++ = '\0';
+		next = value;
+
+		for ( u64 s = 0; same && s < PROJECT_SETUP_FILE_COUNT; ++s )
+		{
+			if ( !string_utf8_compare( name, PROJECT_SETUP_FILES[ s ] ) )
+				continue;
+
+			SetupFileRecord *record = &records[ s ];
+			record->archiveCrc = static_cast<u32>( convert_to_u64( next, &next ) );
+			record->archiveSize = convert_to_u64( next, &next );
+			record->writtenCrc = static_cast<u32>( convert_to_u64( next, &next ) );
+			record->writtenSize = convert_to_u64( next, &next );
+			record->known = true;
+		}
+	}
+
+	fclose( file );
+}
+
+// Written in the project once the placeholders are replaced, with the setup files the archive has and every path it has.
+// Removed when there is neither. Setup files that weren't filled in are left out, whatever is read back for one is checked
+// against the file there, so a stale record only costs an extraction. Written beside the old one and renamed over it,
+// a crash never leaves a list cut short.
+static void project_record_write( const char *folder, u64 substitutions, bool replaced, SetupFileRecord *records, const ExtractFileList *fileList )
+{
+	char path[ MAX_FILEPATH ];
+	string_utf8_format( path, "%s%s", folder, PROJECT_RECORD_FILE );
+
+	char tempPath[ MAX_FILEPATH ];
+	string_utf8_format( tempPath, "%s.tmp", path );
+
+	u64 known = 0;
+
+	for ( u64 s = 0; s < PROJECT_SETUP_FILE_COUNT; ++s )
+	{
+		SetupFileRecord *record = &records[ s ];
+
+		if ( !replaced || !record->known || record->kept )
+		{
+			record->known = replaced && record->known;
+			known += record->known ? 1 : 0;
+			continue;
+		}
+
+		char filePath[ MAX_FILEPATH ];
+		string_utf8_format( filePath, "%s%s", folder, PROJECT_SETUP_FILES[ s ] );
+
+		FILE *fp = fopen( filePath, "rb" );
+		record->known = fp != nullptr;
+
+		if ( !fp )
+			continue;
+
+		u8 buffer[ KB( 4 ) ];
+		u64 bytes;
+
+		record->writtenCrc = crc32( 0, nullptr, 0 );
+		record->writtenSize = 0;
+
+		while ( ( bytes = fread( buffer, 1, sizeof( buffer ), fp ) ) > 0 )
+		{
+			record->writtenCrc = crc32_z( record->writtenCrc, buffer, bytes );
+			record->writtenSize += bytes;
+		}
+
+		record->known = !ferror( fp );
+		known += record->known ? 1 : 0;
+		fclose( fp );
+	}
+
+	FILE *file = known > 0 || fileList->bytes > 0 ? fopen( tempPath, "wb" ) : nullptr;
+
+	if ( !file )
+	{
+		remove( path );
+		return;
+	}
+
+	fprintf( file, "substitutions %llu\n", (unsigned long long)substitutions );
+
+	for ( u64 s = 0; s < PROJECT_SETUP_FILE_COUNT; ++s )
+	{
+		const SetupFileRecord *record = &records[ s ];
+
+		if ( record->known )
+		{
+			fprintf( file, "setup %s %lu %llu %lu %llu\n", PROJECT_SETUP_FILES[ s ], (unsigned long)record->archiveCrc, (unsigned long long)record->archiveSize,
+				(unsigned long)record->writtenCrc, (unsigned long long)record->writtenSize );
+		}
+	}
+
+	if ( fileList->bytes > 0 )
+		fwrite( fileList->data, 1, fileList->bytes, file );
+
+	bool written = ferror( file ) == 0;
+
+	if ( fclose( file ) != 0 || !written )
+	{
+		remove( tempPath );
+		remove( path );
+		return;
+	}
+
+	// Only Windows won't rename over a file, elsewhere the old record is replaced in the same step
+	#ifdef PLATFORM_WINDOWS
+		remove( path );
+	#endif
+
+	if ( rename( tempPath, path ) != 0 )
+	{
+		remove( tempPath );
+		remove( path );
+	}
+}
+
+// Extracts, or copies from the tree cache, a project then renames it into place and fills in its names
+static RESULT_CODE make_project( Project *project, MemoryArena *arena )
+{
+	Source *source = project->source;
+
+	if ( source->result != RESULT_CODE_SUCCESS )
+		return source->result;
+
+	char commitId[ TREE_CACHE_MAX_ID ] = "";
+	bool treeCached = false;
+
+	// A zip archive updates a project already there in place, only writing the files that changed
+	bool incremental = false;
+
+	if ( options.incremental && !source->streamed )
+	{
+		DIR *existing = opendir( project->finalProjectFolder );
+
+		if ( existing )
+		{
+			closedir( existing );
+			incremental = source->format == SOURCE_FORMAT_ZIP;
+
+			if ( !incremental )
+				log( "Only zip archives update a project in place, extracting %s in full.", project->name );
+		}
+	}
+	else if ( options.incremental && source->streamed )
+	{
+		log( "A streamed archive is extracted in full, %s is replaced.", project->name );
+	}
+
+	// The setup files and the paths written are only known from a zip archive extracted here. The record of them is only kept
+	// in a project for -incremental, and only read when updating one in place.
+	SetupFileRecord setupFiles[ PROJECT_SETUP_FILE_COUNT ] = {};
+	ExtractFileList fileList = {};
+	u64 substitutions = setup_substitution_hash( project );
+
+	if ( incremental )
+		project_record_read( project->finalProjectFolder, substitutions, setupFiles );
+
+	// Whatever a run that didn't finish left behind, a streamed project was already extracted here
+	if ( !source->streamed )
+		delete_directory( project->stagingFolder );
+
+	if ( source->streamed )
+	{
+		string_utf8_copy( commitId, source->commitId );
+	}
+	else if ( source->format == SOURCE_FORMAT_TAR_GZ )
+	{
+		TarStream tarStream;
+
+		// The commit id is in a pax header at the start, only the first entry is read to find it
+		if ( options.cacheFolder[ 0 ] != '\0' )
+		{
+			bool probed = read_source_tar_gz( source, &tarStream, &arena->transient, nullptr ) &&
+				tree_cache_commit_id( tarStream.comment, string_utf8_bytes( tarStream.comment ) - 1, commitId );
+
+			tar_stream_free( &tarStream );
+
+			if ( probed && tree_cache_find( options.cacheFolder, commitId ) )
+				treeCached = instantiate_cached_tree( project, commitId );
+		}
+
+		bool extracted = treeCached || read_source_tar_gz( source, &tarStream, &arena->transient, project->stagingFolder );
+
+		if ( !treeCached )
+			tar_stream_free( &tarStream );
+
+		if ( !extracted )
+		{
+			log_error( "Error extracting archive." );
+			return RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE;
+		}
+	}
+	else
+	{
+		// The map reader works from its own index of the central directory, libzip only opens the archive when it can't be mapped
+		ZipMap map = {};
+		bool mapped = options.zipReader == ZIP_READER_MAP && map_source_archive( source, &map );
+		zip_t *z = nullptr;
+
+		if ( !mapped )
+		{
+			if ( options.zipReader == ZIP_READER_MAP )
+				log_error( "Cannot map the zip archive, reading it with libzip." );
+
+			z = open_source_archive( source );
+			if ( !z )
+				return RESULT_CODE_FAILED_TO_OPEN_ARCHIVE;
+		}
+
+		// GitHub archives carry their commit id as the comment, a commit already extracted is copied instead.
+		// Updating in place never copies a cached tree over the project, nor caches one that holds the user's files.
+		// With -incremental the project's record lists every path written, so each one is extracted.
+		if ( options.cacheFolder[ 0 ] != '\0' )
+		{
+			i32 commentBytes = mapped ? map.commentBytes : 0;
+			const char *comment = mapped ? map.comment : zip_get_archive_comment( z, &commentBytes, ZIP_FL_ENC_RAW );
+
+			if ( tree_cache_commit_id( comment, commentBytes, commitId ) && !options.incremental && tree_cache_find( options.cacheFolder, commitId ) )
+				treeCached = instantiate_cached_tree( project, commitId );
+		}
+
+		bool extracted = treeCached;
+
+		if ( !treeCached )
+		{
+			// With libzip, a map is still used for stored entries. Without one every entry is read through libzip.
+			if ( options.zipReader == ZIP_READER_LIBZIP )
+				mapped = map_source_archive( source, &map );
+
+			const char *path = incremental ? project->finalProjectFolder : project->stagingFolder;
+
+			extracted = extract_all_files( source, z, mapped ? &map : nullptr, path, incremental, &arena->transient, app.extractThreads, &project->extractStats, setupFiles,
+				options.incremental ? &fileList : nullptr );
+		}
+
+		if ( mapped )
+			zip_map_close( &map );
+
+		if ( z )
+			zip_close( z );
+
+		if ( !extracted )
+		{
+			free( fileList.data );
+			log_error( "Error unzipping archive." );
+			return RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE;
+		}
+	}
+
+	log( "Unzip Complete." );
+
+	// Keep the tree for the next project made from this commit
+	const char *extractedFolder = incremental ? project->finalProjectFolder : project->stagingFolder;
+
+	if ( project->storeTree && commitId[ 0 ] != '\0' && !treeCached && !incremental && !tree_cache_find( options.cacheFolder, commitId ) )
+	{
+		if ( tree_cache_store( options.cacheFolder, commitId, extractedFolder ) )
+			log( "Cached the extracted tree of commit %s.", commitId );
+		else
+			log_error( "Failed to cache the extracted tree of commit %s.", commitId );
+	}
+
+	// ----------------------------------------
+	// Setup
+	// ----------------------------------------
+
+	// Filled in before the rename, so the project appears with its names already in place.
+	// Every placeholder is found in one pass over each file, the project's own pairs win over those given to every project.
+	Substitute *substitute = arena->transient.allocate<Substitute>( true );
+
+	if ( substitute )
+	{
+		substitute_add( substitute, "__GAME_TEMPLATE_NAME__", project->name );
+
+		for ( u64 i = 0; i < app.variableCount; ++i )
+			substitute_add( substitute, app.variables[ i ].find, app.variables[ i ].replace );
+
+		for ( u64 i = 0; i < project->variableCount; ++i )
+			substitute_add( substitute, project->variables[ i ].find, project->variables[ i ].replace );
+	}
+
+	bool replaced = substitute && substitute_build( substitute, &arena->transient );
+
+	if ( replaced )
+	{
+		// One kept in place was filled in with these same names
+		for ( u64 s = 0; s < PROJECT_SETUP_FILE_COUNT; ++s )
+		{
+			if ( !setupFiles[ s ].kept )
+				replace_placeholders_in_file( extractedFolder, &arena->transient, PROJECT_SETUP_FILES[ s ], substitute );
+		}
+
+		substitute_free( substitute );
+	}
+	else
+	{
+		log_error( "Failed to allocate memory for replacing the placeholders of %s.", project->name );
+	}
+
+	if ( substitute )
+		arena->transient.free( substitute );
+
+	if ( options.incremental )
+		project_record_write( extractedFolder, substitutions, replaced, setupFiles, &fileList );
+
+	free( fileList.data );
+
+	// Each file written was flushed as it was closed, but not those made from the tree cache
+	if ( options.durability == DURABILITY_BATCH || ( options.durability == DURABILITY_FILE && treeCached ) )
+	{
+		u64 syncStart = time_now_us();
+
+		if ( !sync_tree( extractedFolder ) )
+			log_error( "Failed to flush %s to the disk.", extractedFolder );
+
+		project->syncUs = time_now_us() - syncStart;
+	}
+
+	if ( !incremental )
+	{
+		log( "Renaming %s to %s", project->stagingFolder, project->finalProjectFolder );
+
+		// The project appears complete in one rename, a staging folder left by a crash is never mistaken for it.
+		// It is ready without waiting for the one it replaces to be removed.
+		retire_project_folder( project );
+
+		if ( rename( project->stagingFolder, project->finalProjectFolder ) != 0 )
+		{
+			log_error( "Failed to rename %s to %s", project->stagingFolder, project->finalProjectFolder );
+
+			// The project it was to replace is put back as it was
+			if ( project->tombstoneFolder[ 0 ] != '\0' && rename( project->tombstoneFolder, project->finalProjectFolder ) != 0 )
+				log_error( "Failed to put back %s, it is left in %s", project->finalProjectFolder, project->tombstoneFolder );
+
+			return RESULT_CODE_FAILED_TO_MOVE_PROJECT;
+		}
+
+		bury_project_folder( project );
+
+		// The rename itself survives a crash once the folder it was made in is flushed
+		if ( options.durability != DURABILITY_NONE && !sync_folder( project->destFolder ) )
+			log_error( "Failed to flush %s to the disk.", project->destFolder );
+	}
+
+	log( "Setup Complete." );
+
+	return RESULT_CODE_SUCCESS;
+}
+
+// Worker loop, takes the next group of projects until there are none left
+static void make_projects( std::atomic<u64> *nextGroup, MemoryArena *arena )
+{
+	for ( ;; )
+	{
+		u64 group = nextGroup->fetch_add( 1 );
+
+		if ( group >= app.projectCount )
+			return;
+
+		if ( app.projects[ group ].group != group )
+			continue;
+
+		for ( u64 i = group; i < app.projectCount; ++i )
+		{
+			Project *project = &app.projects[ i ];
+
+			if ( project->group != group )
+				continue;
+
+			project->result = make_project( project, arena );
+
+			// Nothing allocated for a project outlives it
+			arena->update();
+		}
+	}
+}
+
+// Moves a downloaded archive into the cache, or removes it, once every project made from it is done
+static void finish_source( Source *source )
+{
+	// Only an archive a project was made from is kept, a bad one would be revalidated and used again every run
+	bool built = false;
+
+	for ( u64 i = 0; i < app.projectCount && !built; ++i )
+		built = app.projects[ i ].source == source && app.projects[ i ].result == RESULT_CODE_SUCCESS;
+
+	// Streamed archives were verified, and went into the cache, as they arrived
+	if ( source->cacheHit && built )
+	{
+		archive_cache_touch( &source->cached );
+	}
+	else if ( source->cacheHit )
+	{
+		log( "No project could be made from the cached archive %s, removing it.", source->cached.archivePath );
+		archive_cache_remove( &source->cached );
+	}
+	else if ( built && !source->streamed && source->result == RESULT_CODE_SUCCESS && options.cacheFolder[ 0 ] != '\0' && ( source->validators.etag[ 0 ] || source->validators.lastModified[ 0 ] ) )
+	{
+		if ( options.inMemory )
+			archive_cache_store_memory( &source->cached, source->archive.data, source->archive.size, &source->validators );
+		else
+			archive_cache_store_file( &source->cached, source->archivePath, &source->validators );
+	}
+
+	if ( options.inMemory )
+		source->archive.free();
+	else
+		remove( source->archivePath );
+
+	if ( options.cacheFolder[ 0 ] != '\0' )
+		archive_cache_evict( options.cacheFolder, options.cacheSize, source->cached.key );
+}
+
+static void print_json_string( const char *text )
+{
+	putchar( '"' );
+
+	for ( const u8 *c = (const u8 *)text; *c; ++c )
+	{
+		if ( *c == '"' || *c == '\\' )
+			printf( "\\%c", *c );
+		else if ( *c < 0x20 )
+			printf( "\\u%04x", *c );
+		else
+			putchar( *c );
+	}
+
+	putchar( '"' );
+}
+
+static const char *DOWNLOAD_ERROR_CLASS_NAME[] =
+{
+	"none",
+	"retryable",
+	"fatal",
+};
+
+static const char *DURABILITY_NAME[] =
+{
+	"none",
+	"file",
+	"batch",
+};
+
+// The downloads of every source, for dashboards to read
+static void print_stats_json( u64 failedProjects )
+{
+	printf( "{\n\t\"projects\": { \"created\": %llu, \"failed\": %llu },\n", (unsigned long long)( app.projectCount - failedProjects ), (unsigned long long)failedProjects );
+
+	// Flushing a file as it is written is counted in its extraction's time, flushing a whole project here
+	u64 syncUs = 0;
+
+	for ( u64 i = 0; i < app.projectCount; ++i )
+		syncUs += app.projects[ i ].syncUs;
+
+	printf( "\t\"durability\": { \"policy\": \"%s\", \"syncUs\": %llu },\n", DURABILITY_NAME[ options.durability ], (unsigned long long)syncUs );
+	printf( "\t\"sources\": [" );
+
+	for ( u64 i = 0; i < app.sourceCount; ++i )
+	{
+		const Source *source = &app.sources[ i ];
+
+		printf( i ? ",\n\t\t{\n" : "\n\t\t{\n" );
+		printf( "\t\t\t\"url\": " );
+		print_json_string( source->url );
+		printf( ",\n\t\t\t\"result\": \"%s\",\n", RESULT_CODE_NAME[ source->result ] );
+		printf( "\t\t\t\"cacheHit\": %s,\n", source->cacheHit ? "true" : "false" );
+		printf( "\t\t\t\"attempts\": [" );
+
+		for ( u64 a = 0; a < source->attempts.count; ++a )
+		{
+			const DownloadAttempt *attempt = &source->attempts.data[ a ];
+			const DownloadTimings *t = &attempt->timings;
+
+			printf( a ? ",\n" : "\n" );
+			printf( "\t\t\t\t{ \"curlCode\": %d, \"error\": ", attempt->result );
+			print_json_string( curl_easy_strerror( attempt->result ) );
+			printf( ", \"httpCode\": %ld, \"class\": \"%s\", \"durationMs\": %llu, \"delayMs\": %llu,\n", attempt->responseCode, DOWNLOAD_ERROR_CLASS_NAME[ attempt->errorClass ],
+				(unsigned long long)attempt->durationMs, (unsigned long long)attempt->delayMs );
+			printf( "\t\t\t\t  \"nameLookupUs\": %llu, \"connectUs\": %llu, \"appConnectUs\": %llu, \"firstByteUs\": %llu, \"totalUs\": %llu,\n",
+				(unsigned long long)t->nameLookupUs, (unsigned long long)t->connectUs, (unsigned long long)t->appConnectUs, (unsigned long long)t->firstByteUs, (unsigned long long)t->totalUs );
+			printf( "\t\t\t\t  \"bytes\": %llu, \"bytesPerSecond\": %llu, \"redirects\": %llu }",
+				(unsigned long long)t->bytes, (unsigned long long)t->bytesPerSecond, (unsigned long long)t->redirects );
+		}
+
+		printf( source->attempts.count ? "\n\t\t\t],\n" : "],\n" );
+		printf( "\t\t\t\"throughput\": { \"peakBytesPerSecond\": %llu, \"intervalMs\": %llu, \"samples\": [",
+			(unsigned long long)source->progress.peakBytesPerSecond, (unsigned long long)source->progress.intervalMs );
+
+		// [ ms since the first attempt started, bytes per second ]
+		for ( u64 k = 0; k < source->progress.sampleCount; ++k )
+		{
+			const DownloadSample *sample = &source->progress.samples[ k ];
+			printf( "%s[ %llu, %llu ]", k ? ", " : " ", (unsigned long long)sample->ms, (unsigned long long)sample->bytesPerSecond );
+		}
+
+		printf( source->progress.sampleCount ? " ] }\n\t\t}" : "] }\n\t\t}" );
+	}
+
+	printf( app.sourceCount ? "\n\t],\n" : "],\n" );
+	printf( "\t\"extractions\": [" );
+
+	u64 extractions = 0;
+
+	// Only zip archives extracted on the pool are scheduled
+	for ( u64 i = 0; i < app.projectCount; ++i )
+	{
+		const Project *project = &app.projects[ i ];
+		const ExtractStats *stats = &project->extractStats;
+
+		if ( stats->files == 0 )
+			continue;
+
+		printf( extractions++ ? ",\n\t\t{ \"project\": " : "\n\t\t{ \"project\": " );
+		print_json_string( project->finalProjectFolder );
+		printf( ", \"files\": %llu, \"tasks\": %llu, \"threads\": %llu, \"wallUs\": %llu, \"workUs\": %llu, \"criticalPathUs\": %llu, \"busiestThreadUs\": %llu, \"unchanged\": %llu, \"removed\": %llu }",
+			(unsigned long long)stats->files, (unsigned long long)stats->tasks, (unsigned long long)stats->threads, (unsigned long long)stats->wallUs,
+			(unsigned long long)stats->workUs, (unsigned long long)stats->criticalPathUs, (unsigned long long)stats->busiestThreadUs,
+			(unsigned long long)stats->unchanged, (unsigned long long)stats->removed );
+	}
+
+	printf( extractions ? "\n\t]\n}\n" : "]\n}\n" );
 }
 
 // ----------------------------------------
@@ -462,51 +3187,6 @@ int main( int argc, const char *argv[] )
 		return usage( RESULT_CODE_INSUFFICIENT_ARGUMENTS );
 	}
 
-	// Memory
-	app.memoryArena =
-	{
-		.flags = 0,
-		.memory = nullptr,
-		.permanent =
-		{
-			.capacity = 0,
-			.available = 0,
-			.memory = nullptr,
-			.lastAlloc = nullptr,
-			.allocate_func = memory_bump_allocate,
-			.reallocate_func = memory_bump_reallocate,
-			.shrink_func = memory_bump_shrink,
-			.free_func = memory_bump_free,
-			.attach_func = memory_bump_attach,
-		},
-		.transient =
-		{
-			.capacity = 0,
-			.available = 0,
-			.memory = nullptr,
-			.lastAlloc = nullptr,
-			.allocate_func = memory_bump_allocate,
-			.reallocate_func = memory_bump_reallocate,
-			.shrink_func = memory_bump_shrink,
-			.free_func = memory_bump_free,
-			.attach_func = memory_bump_attach,
-		},
-		.fastBump =
-		{
-			.capacity = 0,
-			.available = 0,
-			.memory = nullptr,
-			.lastAlloc = nullptr,
-			.allocate_func = memory_fast_bump_allocate,
-			.attach_func = nullptr,
-		},
-	};
-
-	if ( !app.memoryArena.init( options.permanentSize, options.transientSize, options.fastBumpSize, true ) )
-	{
-		return usage( RESULT_CODE_FAILED_TO_INITIALISE_MEMORY_ARENA );
-	}
-
 	// ----------------------------------------
 	// Arguments / Options
 	// ----------------------------------------
@@ -549,9 +3229,212 @@ int main( int argc, const char *argv[] )
 	{
 		if ( index >= argc )
 			return false;
-		string_utf8_copy( options.sourceRepo, "https://github.com/" );
-		string_utf8_append( options.sourceRepo, argv[ ++index ] );
-		string_utf8_append( options.sourceRepo, "/archive/master.zip" );
+		string_utf8_copy( options.sourceRepo, argv[ ++index ] );
+		return true;
+	} );
+
+	// Download the archive into memory rather than a temp file
+	commands.insert( "-memory", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.inMemory = true;
+		options.permanentSize = MB( convert_to_u64( argv[ ++index ] ) );
+		return true;
+	} );
+
+	// Update a project that is already there in place
+	commands.insert( "-incremental", []( i32 &index, int argc, const char *argv[] )
+	{
+		options.incremental = true;
+		return true;
+	} );
+
+	// Set how projects are made from a cached tree
+	commands.insert( "-tree-link", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+
+		const char *link = argv[ ++index ];
+
+		if ( string_utf8_compare( link, "copy" ) )
+			options.treeLink = TREE_LINK_COPY;
+		else if ( string_utf8_compare( link, "clone" ) )
+			options.treeLink = TREE_LINK_CLONE;
+		else if ( string_utf8_compare( link, "hardlink" ) )
+			options.treeLink = TREE_LINK_HARDLINK;
+		else
+			return false;
+
+		return true;
+	} );
+
+	// Set what writes the extracted files
+	commands.insert( "-io", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+
+		const char *backend = argv[ ++index ];
+
+		if ( string_utf8_compare( backend, "stdio" ) )
+			options.ioBackend = IO_BACKEND_STDIO;
+		else if ( string_utf8_compare( backend, "uring" ) )
+			options.ioBackend = IO_BACKEND_URING;
+		else
+			return false;
+
+		return true;
+	} );
+
+	// Set what is flushed to the disk before a project is renamed into place
+	commands.insert( "-durability", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+
+		const char *durability = argv[ ++index ];
+
+		if ( string_utf8_compare( durability, "none" ) )
+			options.durability = DURABILITY_NONE;
+		else if ( string_utf8_compare( durability, "file" ) )
+			options.durability = DURABILITY_FILE;
+		else if ( string_utf8_compare( durability, "batch" ) )
+			options.durability = DURABILITY_BATCH;
+		else
+			return false;
+
+		return true;
+	} );
+
+	// Add a placeholder replaced in every project
+	commands.insert( "-var", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc || options.variableArgCount >= MAX_VARIABLES )
+			return false;
+		options.variableArgs[ options.variableArgCount++ ] = argv[ ++index ];
+		return true;
+	} );
+
+	// Set a file of placeholders replaced in every project
+	commands.insert( "-vars", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		string_utf8_copy( options.variablesFile, argv[ ++index ] );
+		return true;
+	} );
+
+	// Extract the archive while it downloads
+	commands.insert( "-stream", []( i32 &index, int argc, const char *argv[] )
+	{
+		options.stream = true;
+		return true;
+	} );
+
+	// Set the format of the archive to download
+	commands.insert( "-format", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+
+		const char *format = argv[ ++index ];
+
+		if ( string_utf8_compare( format, "zip" ) )
+			options.format = SOURCE_FORMAT_ZIP;
+		else if ( string_utf8_compare( format, "tar.gz" ) || string_utf8_compare( format, "tgz" ) )
+			options.format = SOURCE_FORMAT_TAR_GZ;
+		else
+			return false;
+
+		return true;
+	} );
+
+	// Set what reads the entries of zip archives
+	commands.insert( "-zip-reader", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+
+		const char *reader = argv[ ++index ];
+
+		if ( string_utf8_compare( reader, "libzip" ) )
+			options.zipReader = ZIP_READER_LIBZIP;
+		else if ( string_utf8_compare( reader, "map" ) )
+			options.zipReader = ZIP_READER_MAP;
+		else
+			return false;
+
+		return true;
+	} );
+
+	// Set the number of connections to download the archive over
+	commands.insert( "-connections", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.connections = clamp( convert_to_i32( argv[ ++index ] ), 1, DOWNLOAD_MAX_CONNECTIONS );
+		return true;
+	} );
+
+	// Keep downloaded archives in a cache folder
+	commands.insert( "-cache", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		string_utf8_copy( options.cacheFolder, argv[ ++index ] );
+		char last = options.cacheFolder[ string_utf8_bytes( options.cacheFolder ) - 2 ];
+		if ( last != '\\' && last != '/' )
+		{
+			string_utf8_append( options.cacheFolder, "/" );
+		}
+		return true;
+	} );
+
+	// Set the most the archive cache can hold
+	commands.insert( "-cache-size", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.cacheSize = MB( convert_to_u64( argv[ ++index ] ) );
+		return true;
+	} );
+
+	// Create every project listed in a manifest
+	commands.insert( "-manifest", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		string_utf8_copy( options.manifest, argv[ ++index ] );
+		return true;
+	} );
+
+	// Set the number of projects created at once
+	commands.insert( "-threads", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.threads = clamp( convert_to_i32( argv[ ++index ] ), 1, (i32)MAX_THREADS );
+		return true;
+	} );
+
+	// Set the number of threads extracting each archive
+	commands.insert( "-extract-threads", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.extractThreads = clamp( convert_to_i32( argv[ ++index ] ), 1, (i32)MAX_THREADS );
+		return true;
+	} );
+
+	// Report the downloads when done
+	commands.insert( "-stats", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc || !string_utf8_compare( argv[ index + 1 ], "json" ) )
+			return false;
+		options.stats = STATS_FORMAT_JSON;
+		index += 1;
 		return true;
 	} );
 
@@ -565,7 +3448,38 @@ int main( int argc, const char *argv[] )
 	// Set the number of attempts to download the archive
 	commands.insert( "-attempts", []( i32 &index, int argc, const char *argv[] )
 	{
-		options.attempts = convert_to_i32( argv[ ++index ] );
+		if ( index + 1 >= argc )
+			return false;
+		options.attempts = clamp( convert_to_i32( argv[ ++index ] ), 0, DOWNLOAD_MAX_ATTEMPTS );
+		return true;
+	} );
+
+	// Set the delay before the first retry, and the most it can grow to
+	commands.insert( "-backoff", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 2 >= argc )
+			return false;
+		options.retry.baseDelayMs = max( convert_to_u64( argv[ ++index ] ), (u64)1 );
+		options.retry.maxDelayMs = max( convert_to_u64( argv[ ++index ] ), options.retry.baseDelayMs );
+		return true;
+	} );
+
+	// Set the time limit of each download attempt
+	commands.insert( "-timeout", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 1 >= argc )
+			return false;
+		options.retry.attemptTimeoutMs = convert_to_u64( argv[ ++index ] ) * 1000;
+		return true;
+	} );
+
+	// Abort an attempt that stays below a transfer speed for too long
+	commands.insert( "-low-speed", []( i32 &index, int argc, const char *argv[] )
+	{
+		if ( index + 2 >= argc )
+			return false;
+		options.retry.lowSpeedLimit = convert_to_u64( argv[ ++index ] );
+		options.retry.lowSpeedTime = convert_to_u64( argv[ ++index ] );
 		return true;
 	} );
 
@@ -586,29 +3500,86 @@ int main( int argc, const char *argv[] )
 		}
 	}
 
-	if ( options.projectName[ 0 ] == '\0' )
+	bool manifest = options.manifest[ 0 ] != '\0';
+	u64 manifestBytes = 0;
+
+	if ( manifest )
+	{
+		app.maxProjects = manifest_count( options.manifest, &manifestBytes );
+
+		if ( app.maxProjects == 0 )
+		{
+			log_error( "Failed to open the manifest: %s", options.manifest );
+			return usage( RESULT_CODE_FAILED_TO_OPEN_FILE );
+		}
+	}
+	else
+	{
+		if ( options.projectName[ 0 ] == '\0' )
+		{
+			return usage( RESULT_CODE_MISSING_PROJECT_NAME );
+		}
+
+		if ( options.sourceRepo[ 0 ] == '\0' )
+		{
+			return usage( RESULT_CODE_MISSING_SOURCE_REPO );
+		}
+
+		app.maxProjects = 1;
+	}
+
+	u64 variablesBytes = 0;
+
+	if ( !variables_bytes( &variablesBytes ) )
 	{
-		return usage( RESULT_CODE_MISSING_PROJECT_NAME );
+		log_error( "Failed to open the variables: %s", options.variablesFile );
+		return usage( RESULT_CODE_FAILED_TO_OPEN_FILE );
 	}
 
-	if ( options.sourceRepo[ 0 ] == '\0' )
+	// Memory
+	// The projects, their sources, the manifest and the variables text live in the permanent allocator, after any -memory reserve
+	u64 bookkeeping = app.maxProjects * ( sizeof( Project ) + sizeof( Source ) + sizeof( u64 ) ) + manifestBytes + 1 + variablesBytes + 1 +
+		6 * ( sizeof( MemoryHeader ) + MEMORY_ALIGNMENT );
+
+	if ( !memory_arena_create( &app.memoryArena, options.permanentSize + bookkeeping, options.transientSize, options.fastBumpSize ) )
 	{
-		return usage( RESULT_CODE_MISSING_SOURCE_REPO );
+		return usage( RESULT_CODE_FAILED_TO_INITIALISE_MEMORY_ARENA );
 	}
 
-	string_utf8_copy( options.finalProjectFolder, options.destFolder );
-	string_utf8_append( options.finalProjectFolder, options.projectName );
+	app.projects = app.memoryArena.permanent.allocate<Project>( app.maxProjects );
+	app.sources = app.memoryArena.permanent.allocate<Source>( app.maxProjects );
+	app.tombstones = app.memoryArena.permanent.allocate<u64>( app.maxProjects, true );
 
-	char last = options.finalProjectFolder[ string_utf8_bytes( options.finalProjectFolder ) - 1 ];
-	if ( last != '\\' && last != '/' )
+	if ( !app.projects || !app.sources || !app.tombstones )
+	{
+		return usage( RESULT_CODE_FAILED_TO_ALLOCATE_HEAP_MEMORY );
+	}
+
+	RESULT_CODE variablesResult = variables_parse( variablesBytes );
+	if ( variablesResult != RESULT_CODE_SUCCESS )
+		return usage( variablesResult );
+
+	if ( manifest )
 	{
-		string_utf8_append( options.finalProjectFolder, "/" );
+		RESULT_CODE result = manifest_parse( options.manifest, manifestBytes );
+		if ( result != RESULT_CODE_SUCCESS )
+			return usage( result );
+
+		log( "Running template-downloader" );
+		log( "Manifest: %s ( %llu projects from %llu sources )", options.manifest, (unsigned long long)app.projectCount, (unsigned long long)app.sourceCount );
+
+		if ( options.stream )
+			log( "-stream is ignored with -manifest, each archive is extracted once per project." );
 	}
+	else
+	{
+		add_project( options.projectName, options.destFolder, options.sourceRepo );
 
-	log( "Running template-downloader" );
-	log( "Project: %s", options.projectName );
-	log( "Destination: %s", options.destFolder );
-	log( "Github Source: %s", options.sourceRepo );
+		log( "Running template-downloader" );
+		log( "Project: %s", options.projectName );
+		log( "Destination: %s", options.destFolder );
+		log( "Github Source: %s", app.sources[ 0 ].url );
+	}
 
 	// ----------------------------------------
 	// Download the achive from github
@@ -622,84 +3593,92 @@ int main( int argc, const char *argv[] )
 		return usage( RESULT_CODE_CURL_FAILED_INIT );
 	}
 
-	i32 dlAttempts = options.attempts;
-	CURLcode res;
-	char curlErrorString[ CURL_ERROR_SIZE ];
+	// One handle and one share for every source, connections and TLS sessions carry over
+	download_share_init();
 
-	do
-	{
-		FILE *file = fopen( TEMP_ARCHIVE_FILE, "wb" );
-		if ( !file )
-		{
-			log_error( "Failed to open the file: %s.", TEMP_ARCHIVE_FILE );
-			return usage( RESULT_CODE_FAILED_TO_OPEN_FILE );
-		}
+	// Streaming extracts straight into the only project
+	Project *streamProject = ( options.stream && !manifest ) ? &app.projects[ 0 ] : nullptr;
 
-		curl_easy_setopt( handle, CURLOPT_URL, options.sourceRepo );
-		curl_easy_setopt( handle, CURLOPT_VERBOSE, 0 );
-		curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, 1 );
-		curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, write_data );
-		curl_easy_setopt( handle, CURLOPT_WRITEDATA, file );
-		curl_easy_setopt( handle, CURLOPT_ERRORBUFFER, curlErrorString );
+	for ( u64 i = 0; i < app.sourceCount; ++i )
+	{
+		Source *source = &app.sources[ i ];
 
-		res = curl_easy_perform( handle );
+		if ( manifest )
+			log( "Source: %s", source->url );
 
-		fclose( file );
-	}
-	while ( --dlAttempts >= 0 && res != CURLE_OK );
+		source->result = fetch_source( handle, source, streamProject );
 
-	if ( res != CURLE_OK )
-	{
-		log_error( "A problem has occured." );
-		log_error( "Error: %s", curlErrorString );
-		return usage( RESULT_CODE_FAILED_TO_RETRIEVE_DATA );
+		// What the download needed is finished with
+		app.memoryArena.update();
 	}
 
 	curl_easy_cleanup( handle );
 
-	log( "Archive downloaded." );
-
 	// ----------------------------------------
 	// Unzip the archive
 	// ----------------------------------------
-	i32 err = 0;
-	zip *z = zip_open( TEMP_ARCHIVE_FILE, 0, &err );
+	std::atomic<u64> nextGroup = 0;
+	u64 groupCount = 0;
 
-	if ( !z )
+	for ( u64 i = 0; i < app.projectCount; ++i )
 	{
-		zip_error_t error;
-		zip_error_init_with_code( &error, err );
-		log_error( "Cannot open zip archive '%s': %s", TEMP_ARCHIVE_FILE, zip_error_strerror( &error ) );
-		zip_error_fini( &error );
-		zip_close( z );
-		return usage( RESULT_CODE_FAILED_TO_OPEN_ARCHIVE );
+		if ( app.projects[ i ].group == i )
+			groupCount += 1;
 	}
 
-	if ( !extract_all_files( z, options.destFolder, options.rootFolder, sizeof( options.rootFolder ) ) )
+	u64 threadCount = min<u64>( options.threads, groupCount );
+
+	// Unless told otherwise the cores are shared out between the projects being made at once
+	app.extractThreads = options.extractThreads;
+
+	if ( app.extractThreads == 0 )
+		app.extractThreads = clamp<u64>( std::thread::hardware_concurrency() / max<u64>( threadCount, 1 ), 1, MAX_THREADS );
+
+	app.processId = process_id();
+	app.startWallUs = time_wall_us();
+	std::thread tombstoneRemover( remove_tombstones );
+
+	if ( threadCount <= 1 )
 	{
-		log_error( "Error unzipping archive." );
-		return usage( RESULT_CODE_FAILED_TO_UNZIP_ARCHIVE );
+		make_projects( &nextGroup, &app.memoryArena );
 	}
+	else
+	{
+		log( "Making %llu projects on %llu threads.", (unsigned long long)app.projectCount, (unsigned long long)threadCount );
 
-	zip_close( z );
+		MemoryArena arenas[ MAX_THREADS ];
+		std::thread threads[ MAX_THREADS ];
+		u64 started = 0;
 
-	remove( TEMP_ARCHIVE_FILE );
+		for ( ; started < threadCount; ++started )
+		{
+			if ( !memory_arena_create( &arenas[ started ], 0, options.transientSize, options.fastBumpSize ) )
+				break;
 
-	log( "Unzip Complete." );
+			threads[ started ] = std::thread( make_projects, &nextGroup, &arenas[ started ] );
+		}
 
-	// ----------------------------------------
-	// Setup
-	// ----------------------------------------
+		// Whatever the threads couldn't start for is made here
+		make_projects( &nextGroup, &app.memoryArena );
 
-	log( "Renaming %s to %s", options.rootFolder, options.finalProjectFolder );
+		for ( u64 i = 0; i < started; ++i )
+		{
+			threads[ i ].join();
+			arenas[ i ].free();
+		}
+	}
 
-	delete_directory( options.finalProjectFolder );
-	rename( options.rootFolder, options.finalProjectFolder );
+	{
+		std::lock_guard<std::mutex> lock( app.tombstoneMutex );
+		app.projectsMade = true;
+		app.tombstoneQueued.notify_one();
+	}
 
-	replace_entry_in_file( "run.bat", "__GAME_TEMPLATE_NAME__", options.projectName );
-	replace_entry_in_file( "build.bat", "__GAME_TEMPLATE_NAME__", options.projectName );
+	for ( u64 i = 0; i < app.sourceCount; ++i )
+		finish_source( &app.sources[ i ] );
 
-	log( "Setup Complete." );
+	log( "Waiting for the replaced projects to be removed." );
+	tombstoneRemover.join();
 
 	// ----------------------------------------
 	// Clean up
@@ -707,11 +3686,48 @@ int main( int argc, const char *argv[] )
 
 	log( "Cleaning Up." );
 
+	download_share_cleanup();
 	curl_global_cleanup();
 
-	return RESULT_CODE_SUCCESS;
+	RESULT_CODE result = RESULT_CODE_SUCCESS;
+	u64 failed = 0;
+
+	for ( u64 i = 0; i < app.projectCount; ++i )
+	{
+		const Project *project = &app.projects[ i ];
+
+		if ( project->result == RESULT_CODE_SUCCESS )
+			continue;
+
+		if ( manifest )
+			log_error( "Project %s%s failed: %s", project->destFolder, project->name, RESULT_CODE_NAME[ project->result ] );
+
+		if ( failed++ == 0 )
+			result = project->result;
+	}
+
+	// The report is all that goes to stdout, so it can be piped
+	if ( options.stats == STATS_FORMAT_JSON )
+		print_stats_json( failed );
+	else if ( manifest )
+		printf( "%llu of %llu projects created.\n", (unsigned long long)( app.projectCount - failed ), (unsigned long long)app.projectCount );
+
+	if ( !manifest && result != RESULT_CODE_SUCCESS )
+		return usage( result );
+
+	return result;
 }
 
 // --------------------------------------------------------------------------------
 // Unity build
-#include "utility.cpp"
\ No newline at end of file
+#include "utility.cpp"
+#include "zip_stream.cpp"
+#include "tar_stream.cpp"
+#include "zip_map.cpp"
+#include "directory_cache.cpp"
+#include "tree_remove.cpp"
+#include "uring_writer.cpp"
+#include "download.cpp"
+#include "archive_cache.cpp"
+#include "tree_cache.cpp"
+#include "substitute.cpp"
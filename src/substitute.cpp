@@ -0,0 +1,170 @@
+// SUBSTITUTE ///////////////////////////////////////////////////////////////////////////
+bool substitute_add( Substitute *substitute, const char *find, const char *replace )
+{
+	u64 findBytes = string_utf8_bytes( find ) - 1;
+
+	if ( findBytes == 0 || substitute->patternCount >= SUBSTITUTE_MAX_PATTERNS )
+		return false;
+
+	substitute->patterns[ substitute->patternCount++ ] = { .find = find, .findBytes = findBytes, .replace = replace, .replaceBytes = string_utf8_bytes( replace ) - 1 };
+
+	return true;
+}
+
+bool substitute_build( Substitute *substitute, Allocator *allocator )
+{
+	substitute->allocator = allocator;
+	substitute->classCount = 1;
+	substitute->nodeCount = 1;
+
+	u64 maxNodes = 1;
+
+	for ( u64 p = 0; p < substitute->patternCount; ++p )
+	{
+		const SubstitutePattern *pattern = &substitute->patterns[ p ];
+		maxNodes += pattern->findBytes;
+
+		for ( u64 i = 0; i < pattern->findBytes; ++i )
+		{
+			u8 byte = static_cast<u8>( pattern->find[ i ] );
+
+			if ( substitute->classes[ byte ] == 0 )
+				substitute->classes[ byte ] = static_cast<u16>( substitute->classCount++ );
+		}
+	}
+
+	u64 classCount = substitute->classCount;
+
+	// 0 is the root, it is also what a trie edge that isn't there reads as, no edge leads back to the root
+	substitute->next = allocator->allocate<u32>( maxNodes * classCount, true );
+	substitute->match = allocator->allocate<u32>( maxNodes, true );
+	substitute->depth = allocator->allocate<u32>( maxNodes, true );
+	u32 *fail = allocator->allocate<u32>( maxNodes, true );
+	u32 *queue = allocator->allocate<u32>( maxNodes );
+
+	if ( !substitute->next || !substitute->match || !substitute->depth || !fail || !queue )
+	{
+		if ( queue )
+			allocator->free( queue );
+		if ( fail )
+			allocator->free( fail );
+
+		substitute_free( substitute );
+		return false;
+	}
+
+	u32 *next = substitute->next;
+
+	// The trie, each placeholder's last node holds its index + 1 and every node how many bytes lead to it
+	for ( u64 p = 0; p < substitute->patternCount; ++p )
+	{
+		const SubstitutePattern *pattern = &substitute->patterns[ p ];
+		u32 node = 0;
+
+		for ( u64 i = 0; i < pattern->findBytes; ++i )
+		{
+			u32 *edge = &next[ node * classCount + substitute->classes[ static_cast<u8>( pattern->find[ i ] ) ] ];
+
+			if ( *edge == 0 )
+			{
+				*edge = static_cast<u32>( substitute->nodeCount++ );
+				substitute->depth[ *edge ] = substitute->depth[ node ] + 1;
+			}
+
+			node = *edge;
+		}
+
+		substitute->match[ node ] = static_cast<u32>( p + 1 );
+	}
+
+	// Breadth first, so a node's failure is always done before it. The edges it doesn't have become its failure's,
+	// and a node that ends no placeholder of its own ends the longest its failure does.
+	u64 head = 0;
+	u64 tail = 0;
+
+	for ( u64 c = 0; c < classCount; ++c )
+	{
+		if ( next[ c ] )
+			queue[ tail++ ] = next[ c ];
+	}
+
+	while ( head < tail )
+	{
+		u32 node = queue[ head++ ];
+
+		if ( substitute->match[ node ] == 0 )
+			substitute->match[ node ] = substitute->match[ fail[ node ] ];
+
+		for ( u64 c = 0; c < classCount; ++c )
+		{
+			u32 *edge = &next[ node * classCount + c ];
+			u32 failEdge = next[ fail[ node ] * classCount + c ];
+
+			if ( *edge )
+			{
+				fail[ *edge ] = failEdge;
+				queue[ tail++ ] = *edge;
+			}
+			else
+			{
+				*edge = failEdge;
+			}
+		}
+	}
+
+	allocator->free( queue );
+	allocator->free( fail );
+
+	return true;
+}
+
+void substitute_free( Substitute *substitute )
+{
+	if ( substitute->depth )
+		substitute->allocator->free( substitute->depth );
+	if ( substitute->match )
+		substitute->allocator->free( substitute->match );
+	if ( substitute->next )
+		substitute->allocator->free( substitute->next );
+
+	substitute->depth = nullptr;
+	substitute->match = nullptr;
+	substitute->next = nullptr;
+}
+
+bool substitute_next( const Substitute *substitute, const u8 *data, u64 size, u64 *offset, SubstituteMatch *match )
+{
+	const u32 *next = substitute->next;
+	u64 classCount = substitute->classCount;
+	u32 state = 0;
+	bool found = false;
+
+	for ( u64 i = *offset; i < size; ++i )
+	{
+		state = next[ state * classCount + substitute->classes[ data[ i ] ] ];
+
+		// The state's depth is the most bytes back a placeholder still being matched can start, once that is after
+		// the one found nothing longer or further left can follow
+		if ( found && i + 1 - substitute->depth[ state ] > match->start )
+			break;
+
+		if ( substitute->match[ state ] )
+		{
+			// The longest ending here, so the one starting first. The search starts from the root at offset,
+			// so the placeholder can't begin before it
+			const SubstitutePattern *pattern = &substitute->patterns[ substitute->match[ state ] - 1 ];
+			u64 start = i + 1 - pattern->findBytes;
+
+			if ( !found || start <= match->start )
+			{
+				match->start = start;
+				match->pattern = pattern;
+				found = true;
+			}
+		}
+	}
+
+	*offset = found ? match->start + match->pattern->findBytes : size;
+
+	return found;
+}
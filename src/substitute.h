@@ -0,0 +1,48 @@
+#pragma once
+
+#define SUBSTITUTE_MAX_PATTERNS			( 80 )
+
+// A placeholder and what it is replaced with
+struct SubstitutePattern
+{
+	const char *find;
+	u64 findBytes;
+	const char *replace;
+	u64 replaceBytes;
+};
+
+// Every placeholder compiled into one Aho-Corasick automaton, the failure links folded into a full transition table
+// so each byte of a file is a single lookup. Bytes that are in no placeholder share one column of the table.
+struct Substitute
+{
+	SubstitutePattern patterns[ SUBSTITUTE_MAX_PATTERNS ];
+	u64 patternCount;
+
+	Allocator *allocator;
+	u16 classes[ 256 ];
+	u64 classCount;
+	u32 *next;
+	u32 *match;
+	u32 *depth;
+	u64 nodeCount;
+};
+
+// A placeholder found, and where
+struct SubstituteMatch
+{
+	u64 start;
+	const SubstitutePattern *pattern;
+};
+
+// Adds a placeholder, given again the last replacement wins
+// @return false if find is empty or there are too many
+bool substitute_add( Substitute *substitute, const char *find, const char *replace );
+
+// Compiles the placeholders added, call once they all are
+bool substitute_build( Substitute *substitute, Allocator *allocator );
+void substitute_free( Substitute *substitute );
+
+// Finds the next placeholder at or after offset, offset is moved past it. Where placeholders overlap the one that starts first
+// is found, the longest of those starting at the same byte, and the search carries on after it.
+// @return false if there are no more
+bool substitute_next( const Substitute *substitute, const u8 *data, u64 size, u64 *offset, SubstituteMatch *match );
@@ -0,0 +1,566 @@
+// TAR STREAM ///////////////////////////////////////////////////////////////////////////
+static bool tar_stream_error( TarStream *ts )
+{
+	ts->state = TAR_STREAM_STATE_ERROR;
+	return false;
+}
+
+// Copies input into the header until it holds 'needed' bytes. Returns true once it does.
+static bool tar_stream_gather( TarStream *ts, const u8 **data, u64 *bytes, u64 needed )
+{
+	if ( ts->headerSize < needed )
+	{
+		u64 take = min( needed - ts->headerSize, *bytes );
+		memcpy( ts->header + ts->headerSize, *data, take );
+		ts->headerSize += take;
+		*data += take;
+		*bytes -= take;
+	}
+
+	return ts->headerSize >= needed;
+}
+
+// Numeric fields are octal text, or big endian base-256 when the high bit of the first byte is set
+static bool tar_stream_read_number( const u8 *field, u64 bytes, u64 *value )
+{
+	*value = 0;
+
+	if ( field[ 0 ] & 0x80 )
+	{
+		for ( u64 i = 0; i < bytes; ++i )
+			*value = ( *value << 8 ) | ( i == 0 ? field[ i ] & 0x7F : field[ i ] );
+
+		return true;
+	}
+
+	u64 i = 0;
+
+	while ( i < bytes && field[ i ] == ' ' )
+		++i;
+
+	for ( ; i < bytes && field[ i ] != ' ' && field[ i ] != '\0'; ++i )
+	{
+		if ( field[ i ] < '0' || field[ i ] > '7' )
+			return false;
+
+		*value = ( *value << 3 ) | ( field[ i ] - '0' );
+	}
+
+	return true;
+}
+
+// Names that would land outside the destination folder are refused
+static bool tar_stream_safe_name( const char *name )
+{
+	if ( name[ 0 ] == '/' || name[ 0 ] == '\\' || ( name[ 0 ] != '\0' && name[ 1 ] == ':' ) )
+		return false;
+
+	for ( const char *c = name; *c; )
+	{
+		if ( c[ 0 ] == '.' && c[ 1 ] == '.' && ( c[ 2 ] == '/' || c[ 2 ] == '\\' || c[ 2 ] == '\0' ) )
+			return false;
+
+		while ( *c && *c != '/' && *c != '\\' )
+			++c;
+
+		while ( *c == '/' || *c == '\\' )
+			++c;
+	}
+
+	return true;
+}
+
+static bool tar_stream_skip( TarStream *ts, u64 bytes )
+{
+	ts->skipRemaining = bytes;
+	ts->state = bytes ? TAR_STREAM_STATE_SKIP : TAR_STREAM_STATE_HEADER;
+	ts->headerSize = 0;
+
+	return true;
+}
+
+static u64 tar_stream_padding( u64 size )
+{
+	return ( TAR_STREAM_BLOCK_SIZE - ( size % TAR_STREAM_BLOCK_SIZE ) ) % TAR_STREAM_BLOCK_SIZE;
+}
+
+static bool tar_stream_finish_entry( TarStream *ts )
+{
+	if ( ts->file )
+	{
+		bool closed = close_file( ts->file, ts->syncFiles );
+		ts->file = nullptr;
+
+		if ( !closed )
+		{
+			log_error( "Failed writing extracted file: %s", ts->name );
+			return tar_stream_error( ts );
+		}
+	}
+
+	ts->entryCount += 1;
+	ts->hasLongName = false;
+	ts->hasLongSize = false;
+
+	return tar_stream_skip( ts, tar_stream_padding( ts->size ) );
+}
+
+// pax records are "<length> <key>=<value>\n"
+static bool tar_stream_read_pax( TarStream *ts, bool global )
+{
+	const char *p = (const char *)ts->header;
+	const char *end = p + ts->size;
+
+	while ( p < end )
+	{
+		u64 length = 0;
+		const char *c = p;
+
+		while ( c < end && *c >= '0' && *c <= '9' )
+			length = length * 10 + ( *c++ - '0' );
+
+		if ( c >= end || *c != ' ' || length == 0 || length > (u64)( end - p ) || p[ length - 1 ] != '\n' )
+		{
+			log_error( "Invalid pax header in archive." );
+			return tar_stream_error( ts );
+		}
+
+		const char *key = c + 1;
+		const char *recordEnd = p + length - 1;
+		const char *equals = key;
+
+		while ( equals < recordEnd && *equals != '=' )
+			++equals;
+
+		const char *value = equals + 1;
+		u64 keyBytes = equals - key;
+		u64 valueBytes = equals < recordEnd ? recordEnd - value : 0;
+
+		if ( global )
+		{
+			if ( keyBytes == 7 && memcmp( key, "comment", 7 ) == 0 )
+				string_utf8_copy( ts->comment, value, min<u64>( valueBytes, sizeof( ts->comment ) - 1 ) );
+		}
+		else if ( keyBytes == 4 && memcmp( key, "path", 4 ) == 0 )
+		{
+			if ( valueBytes >= sizeof( ts->longName ) )
+			{
+				log_error( "Archive entry name is too long." );
+				return tar_stream_error( ts );
+			}
+
+			string_utf8_copy( ts->longName, value, valueBytes );
+			ts->hasLongName = true;
+		}
+		else if ( keyBytes == 4 && memcmp( key, "size", 4 ) == 0 )
+		{
+			ts->longSize = 0;
+
+			for ( const char *d = value; d < recordEnd; ++d )
+				ts->longSize = ts->longSize * 10 + ( *d - '0' );
+
+			ts->hasLongSize = true;
+		}
+
+		p += length;
+	}
+
+	return true;
+}
+
+static bool tar_stream_finish_extended( TarStream *ts )
+{
+	switch ( ts->type )
+	{
+		case TAR_TYPE_PAX_EXTENDED:
+		case TAR_TYPE_PAX_GLOBAL:
+		{
+			if ( !tar_stream_read_pax( ts, ts->type == TAR_TYPE_PAX_GLOBAL ) )
+				return false;
+		}
+		break;
+
+		case TAR_TYPE_GNU_LONG_NAME:
+		{
+			u64 nameBytes = strnlen( (const char *)ts->header, ts->size );
+
+			if ( nameBytes >= sizeof( ts->longName ) )
+			{
+				log_error( "Archive entry name is too long." );
+				return tar_stream_error( ts );
+			}
+
+			string_utf8_copy( ts->longName, (const char *)ts->header, nameBytes );
+			ts->hasLongName = true;
+		}
+		break;
+
+		default:
+		break;
+	}
+
+	return tar_stream_skip( ts, tar_stream_padding( ts->size ) );
+}
+
+static bool tar_stream_open_entry( TarStream *ts )
+{
+	const u8 *h = ts->header;
+
+	// The archive ends with two zeroed blocks
+	u32 checksum = 0;
+	bool zero = true;
+
+	for ( u64 i = 0; i < TAR_STREAM_BLOCK_SIZE; ++i )
+	{
+		checksum += ( i >= 148 && i < 156 ) ? ' ' : h[ i ];
+		zero = zero && h[ i ] == 0;
+	}
+
+	ts->headerSize = 0;
+
+	if ( zero )
+	{
+		if ( ++ts->zeroBlocks == 2 )
+			ts->state = TAR_STREAM_STATE_DONE;
+
+		return true;
+	}
+
+	ts->zeroBlocks = 0;
+
+	u64 expected;
+
+	if ( !tar_stream_read_number( h + 148, 8, &expected ) || expected != checksum )
+	{
+		log_error( "Invalid header checksum in archive." );
+		return tar_stream_error( ts );
+	}
+
+	if ( !tar_stream_read_number( h + 124, 12, &ts->size ) )
+	{
+		log_error( "Invalid entry size in archive." );
+		return tar_stream_error( ts );
+	}
+
+	ts->type = static_cast<char>( h[ 156 ] );
+	ts->written = 0;
+
+	// Extended headers describe the entry after them
+	if ( ts->type == TAR_TYPE_PAX_EXTENDED || ts->type == TAR_TYPE_PAX_GLOBAL || ts->type == TAR_TYPE_GNU_LONG_NAME || ts->type == TAR_TYPE_GNU_LONG_LINK )
+	{
+		if ( ts->size > TAR_STREAM_HEADER_SIZE )
+		{
+			log_error( "Extended header of %llu bytes is too large.", (unsigned long long)ts->size );
+			return tar_stream_error( ts );
+		}
+
+		ts->state = TAR_STREAM_STATE_EXTENDED;
+
+		if ( ts->size == 0 )
+			return tar_stream_finish_extended( ts );
+
+		return true;
+	}
+
+	if ( ts->hasLongSize )
+		ts->size = ts->longSize;
+
+	if ( ts->hasLongName )
+	{
+		string_utf8_copy( ts->name, ts->longName );
+	}
+	else
+	{
+		// ustar splits long names into a prefix and a name
+		ts->name[ 0 ] = '\0';
+
+		if ( memcmp( h + 257, "ustar", 5 ) == 0 && h[ 345 ] != '\0' )
+		{
+			string_utf8_copy( ts->name, (const char *)h + 345, strnlen( (const char *)h + 345, 155 ) );
+			string_utf8_append( ts->name, "/" );
+		}
+
+		u64 offset = string_utf8_bytes( ts->name ) - 1;
+		string_utf8_copy( ts->name + offset, sizeof( ts->name ) - offset, (const char *)h, strnlen( (const char *)h, 100 ) );
+	}
+
+	u64 nameBytes = string_utf8_bytes( ts->name ) - 1;
+
+	if ( nameBytes == 0 || !tar_stream_safe_name( ts->name ) )
+	{
+		log_error( "Invalid archive entry name: %s", ts->name );
+		return tar_stream_error( ts );
+	}
+
+	bool folder = ts->type == TAR_TYPE_DIRECTORY;
+	bool file = ts->type == TAR_TYPE_FILE || ts->type == TAR_TYPE_FILE_OLD || ts->type == TAR_TYPE_CONTIGUOUS;
+
+	if ( folder && ts->name[ nameBytes - 1 ] != '/' && nameBytes + 1 < sizeof( ts->name ) )
+		string_utf8_append( ts->name, "/" );
+
+	if ( !folder && !file )
+	{
+		log( "Skipping archive entry of type '%c': %s", ts->type, ts->name );
+
+		ts->hasLongName = false;
+		ts->hasLongSize = false;
+
+		return tar_stream_skip( ts, ts->size + tar_stream_padding( ts->size ) );
+	}
+
+	if ( ts->entryCount == 0 )
+	{
+		ts->rootBytes = archive_root_bytes( ts->name );
+		string_utf8_copy( ts->root, ts->name, ts->rootBytes );
+	}
+
+	if ( ts->path )
+	{
+		char filePath[ MAX_FILEPATH ];
+		string_utf8_copy( filePath, ts->path );
+		string_utf8_append( filePath, ts->name + archive_root_skip( ts->name, ts->root, ts->rootBytes ) );
+
+		if ( folder )
+		{
+			if ( !make_directory( filePath ) )
+				return tar_stream_error( ts );
+		}
+		else
+		{
+			ts->file = fopen( filePath, "wb" );
+
+			// Tarballs don't always list the folders before their files
+			if ( !ts->file )
+			{
+				char *separator = strrchr( filePath, '/' );
+				*separator = '\0';
+
+				if ( make_directory( filePath ) )
+				{
+					*separator = '/';
+					ts->file = fopen( filePath, "wb" );
+				}
+
+				*separator = '/';
+			}
+
+			if ( !ts->file )
+			{
+				log_error( "Error opening file: %s", filePath );
+				return tar_stream_error( ts );
+			}
+		}
+	}
+
+	// Directories carry no data
+	if ( folder || ts->size == 0 )
+	{
+		ts->size = 0;
+		return tar_stream_finish_entry( ts );
+	}
+
+	ts->state = TAR_STREAM_STATE_DATA;
+
+	return true;
+}
+
+// Takes the inflated tar bytes
+static bool tar_stream_consume( TarStream *ts, const u8 *data, u64 bytes )
+{
+	while ( bytes > 0 )
+	{
+		switch ( ts->state )
+		{
+			case TAR_STREAM_STATE_HEADER:
+			{
+				if ( tar_stream_gather( ts, &data, &bytes, TAR_STREAM_BLOCK_SIZE ) && !tar_stream_open_entry( ts ) )
+					return false;
+			}
+			break;
+
+			case TAR_STREAM_STATE_EXTENDED:
+			{
+				if ( tar_stream_gather( ts, &data, &bytes, ts->size ) && !tar_stream_finish_extended( ts ) )
+					return false;
+			}
+			break;
+
+			case TAR_STREAM_STATE_DATA:
+			{
+				u64 take = min( ts->size - ts->written, bytes );
+
+				if ( ts->file && fwrite( data, 1, take, ts->file ) != take )
+				{
+					log_error( "Failed writing extracted file: %s", ts->name );
+					return tar_stream_error( ts );
+				}
+
+				ts->written += take;
+				data += take;
+				bytes -= take;
+
+				if ( ts->written == ts->size && !tar_stream_finish_entry( ts ) )
+					return false;
+			}
+			break;
+
+			case TAR_STREAM_STATE_SKIP:
+			{
+				u64 take = min( ts->skipRemaining, bytes );
+				ts->skipRemaining -= take;
+				data += take;
+				bytes -= take;
+
+				if ( ts->skipRemaining == 0 )
+				{
+					ts->state = TAR_STREAM_STATE_HEADER;
+					ts->headerSize = 0;
+				}
+			}
+			break;
+
+			case TAR_STREAM_STATE_DONE:
+			{
+				// Archives are padded out to a whole record after the end marker
+				bytes = 0;
+			}
+			break;
+
+			case TAR_STREAM_STATE_ERROR:
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool tar_stream_begin( TarStream *ts, Allocator *allocator, const char *path )
+{
+	*ts = {};
+
+	ts->state = TAR_STREAM_STATE_HEADER;
+	ts->allocator = allocator;
+	ts->path = path;
+	ts->header = allocator->allocate<u8>( TAR_STREAM_HEADER_SIZE );
+	ts->output = allocator->allocate<u8>( TAR_STREAM_OUTPUT_SIZE );
+
+	if ( !ts->header || !ts->output )
+	{
+		log_error( "Failed to allocate memory for streaming extraction." );
+		tar_stream_free( ts );
+		return false;
+	}
+
+	// 16 + window bits reads a gzip wrapper, the trailer's CRC and length are checked by zlib
+	if ( inflateInit2( &ts->inflater, 16 + MAX_WBITS ) != Z_OK )
+	{
+		log_error( "Failed to initialise inflate for the archive." );
+		tar_stream_free( ts );
+		return false;
+	}
+
+	ts->inflaterActive = true;
+
+	return !path || make_directory( path );
+}
+
+bool tar_stream_write( TarStream *ts, const u8 *data, u64 bytes )
+{
+	ts->bytesIn += bytes;
+
+	while ( bytes > 0 && ts->state != TAR_STREAM_STATE_ERROR )
+	{
+		if ( ts->gzipEnded )
+		{
+			// Whatever follows the last member once the tar has ended is ignored
+			if ( ts->state == TAR_STREAM_STATE_DONE )
+				return true;
+
+			// Otherwise it is another gzip member
+			if ( inflateReset( &ts->inflater ) != Z_OK )
+				return tar_stream_error( ts );
+
+			ts->gzipEnded = false;
+		}
+
+		u64 available = min( bytes, (u64)UINT32_MAX );
+		i32 result;
+
+		ts->inflater.next_in = (Bytef *)data;
+		ts->inflater.avail_in = static_cast<uInt>( available );
+
+		do
+		{
+			ts->inflater.next_out = ts->output;
+			ts->inflater.avail_out = TAR_STREAM_OUTPUT_SIZE;
+
+			result = inflate( &ts->inflater, Z_NO_FLUSH );
+
+			if ( result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR )
+			{
+				log_error( "Failed to inflate archive: %s", ts->inflater.msg ? ts->inflater.msg : "unknown error" );
+				return tar_stream_error( ts );
+			}
+
+			if ( !tar_stream_consume( ts, ts->output, TAR_STREAM_OUTPUT_SIZE - ts->inflater.avail_out ) )
+				return false;
+		}
+		while ( result == Z_OK && ( ts->inflater.avail_in > 0 || ts->inflater.avail_out == 0 ) );
+
+		u64 consumed = available - ts->inflater.avail_in;
+		data += consumed;
+		bytes -= consumed;
+
+		if ( result == Z_STREAM_END )
+			ts->gzipEnded = true;
+	}
+
+	return ts->state != TAR_STREAM_STATE_ERROR;
+}
+
+bool tar_stream_end( TarStream *ts )
+{
+	if ( ts->state == TAR_STREAM_STATE_ERROR )
+		return false;
+
+	if ( !ts->gzipEnded )
+	{
+		log_error( "Archive ended before the end of its gzip stream." );
+		return tar_stream_error( ts );
+	}
+
+	if ( ts->state != TAR_STREAM_STATE_DONE )
+	{
+		log_error( "Archive ended before the end of archive marker." );
+		return tar_stream_error( ts );
+	}
+
+	return true;
+}
+
+void tar_stream_free( TarStream *ts )
+{
+	if ( ts->file )
+	{
+		fclose( ts->file );
+		ts->file = nullptr;
+	}
+
+	if ( ts->inflaterActive )
+	{
+		inflateEnd( &ts->inflater );
+		ts->inflaterActive = false;
+	}
+
+	// Reverse order of allocation so the bump allocator can rewind
+	if ( ts->output )
+		ts->allocator->free( ts->output );
+
+	if ( ts->header )
+		ts->allocator->free( ts->header );
+
+	ts->output = nullptr;
+	ts->header = nullptr;
+}
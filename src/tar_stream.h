@@ -0,0 +1,82 @@
+#pragma once
+
+#define TAR_STREAM_OUTPUT_SIZE		( KB( 64 ) )
+#define TAR_STREAM_HEADER_SIZE		( KB( 64 ) )
+#define TAR_STREAM_BLOCK_SIZE		( 512 )
+#define TAR_STREAM_MAX_NAME			( 4096 )
+#define TAR_STREAM_MAX_COMMENT		( 256 )
+
+constexpr const char TAR_TYPE_FILE = '0';
+constexpr const char TAR_TYPE_FILE_OLD = '\0';
+constexpr const char TAR_TYPE_HARD_LINK = '1';
+constexpr const char TAR_TYPE_SYMBOLIC_LINK = '2';
+constexpr const char TAR_TYPE_DIRECTORY = '5';
+constexpr const char TAR_TYPE_CONTIGUOUS = '7';
+constexpr const char TAR_TYPE_PAX_EXTENDED = 'x';
+constexpr const char TAR_TYPE_PAX_GLOBAL = 'g';
+constexpr const char TAR_TYPE_GNU_LONG_NAME = 'L';
+constexpr const char TAR_TYPE_GNU_LONG_LINK = 'K';
+
+enum TAR_STREAM_STATE
+{
+	TAR_STREAM_STATE_HEADER,
+	TAR_STREAM_STATE_EXTENDED,
+	TAR_STREAM_STATE_DATA,
+	TAR_STREAM_STATE_SKIP,
+	TAR_STREAM_STATE_DONE,
+	TAR_STREAM_STATE_ERROR,
+};
+
+// Extracts a tar.gz archive as its bytes arrive, gzip is inflated and the tar entries written in one pass.
+// Memory is the inflate output and one header buffer, whatever the size of the archive.
+// Without a path nothing is written, the headers are only read ( for the comment ).
+struct TarStream
+{
+	TAR_STREAM_STATE state;
+	Allocator *allocator;
+	const char *path;
+
+	// Named by the first entry, left out of every path inside it
+	char root[ TAR_STREAM_MAX_NAME ];
+	u64 rootBytes;
+
+	// Headers, and pax / GNU extended header data, are gathered here until complete
+	u8 *header;
+	u64 headerSize;
+	u64 skipRemaining;
+	u64 zeroBlocks;
+
+	// Set by extended headers for the entry that follows them
+	char longName[ TAR_STREAM_MAX_NAME ];
+	u64 longSize;
+	bool hasLongName;
+	bool hasLongSize;
+
+	// Current entry
+	char name[ TAR_STREAM_MAX_NAME ];
+	char type;
+	u64 size;
+	u64 written;
+	FILE *file;
+
+	// Set after tar_stream_begin, each extracted file is flushed to the disk as it is closed
+	bool syncFiles;
+
+	z_stream inflater;
+	bool inflaterActive;
+	bool gzipEnded;
+	u8 *output;
+
+	u64 entryCount;
+
+	// Bytes of the archive received so far, where a resumed download continues from
+	u64 bytesIn;
+
+	// GitHub puts the commit id in a pax global header
+	char comment[ TAR_STREAM_MAX_COMMENT ];
+};
+
+bool tar_stream_begin( TarStream *ts, Allocator *allocator, const char *path );
+bool tar_stream_write( TarStream *ts, const u8 *data, u64 bytes );
+bool tar_stream_end( TarStream *ts );
+void tar_stream_free( TarStream *ts );
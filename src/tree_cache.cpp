@@ -0,0 +1,162 @@
+// TREE CACHE ///////////////////////////////////////////////////////////////////////////
+bool tree_cache_commit_id( const char *comment, u64 length, char *commitId )
+{
+	if ( !comment || ( length != 40 && length != 64 ) )
+		return false;
+
+	for ( u64 i = 0; i < length; ++i )
+	{
+		char c = ascii_char_lower( comment[ i ] );
+
+		if ( ( c < '0' || c > '9' ) && ( c < 'a' || c > 'f' ) )
+		{
+			commitId[ 0 ] = '\0';
+			return false;
+		}
+
+		commitId[ i ] = c;
+	}
+
+	commitId[ length ] = '\0';
+
+	return true;
+}
+
+void tree_cache_path( const char *cacheFolder, const char *commitId, char *path, u64 maxPath )
+{
+	string_utf8_format( path, maxPath, "%s%s%s/", cacheFolder, TREE_CACHE_FOLDER, commitId );
+}
+
+bool tree_cache_find( const char *cacheFolder, const char *commitId )
+{
+	char path[ TREE_CACHE_MAX_PATH ];
+	tree_cache_path( cacheFolder, commitId, path, sizeof( path ) );
+
+	DIR *dir = opendir( path );
+	if ( !dir )
+		return false;
+
+	closedir( dir );
+
+	return true;
+}
+
+// Makes one file of a tree the cheapest way the link allows
+static bool tree_cache_make_file( const char *from, const char *to, TREE_LINK link, bool own, TreeCacheLinks *links )
+{
+	bool shared = false;
+
+	// Hard links only for files nothing rewrites, and only when the blocks can't just be shared
+	if ( link == TREE_LINK_HARDLINK && !own && !clone_file( from, to, false, &shared ) && link_file( from, to ) )
+	{
+		links->linked += 1;
+		return true;
+	}
+
+	bool made = shared || ( link == TREE_LINK_COPY ? copy_file( from, to ) : clone_file( from, to, true, &shared ) );
+	if ( !made )
+		return false;
+
+	if ( shared )
+		links->shared += 1;
+	else
+		links->copied += 1;
+
+	return true;
+}
+
+// Both folders end with a separator, the own files are relative to the folder at rootBytes into to
+static bool tree_cache_copy( const char *from, const char *to, u64 rootBytes, TREE_LINK link, const char *const *ownFiles, u64 ownFileCount, TreeCacheLinks *links )
+{
+	if ( !make_directory( to ) )
+		return false;
+
+	DIR *dir = opendir( from );
+	if ( !dir )
+		return false;
+
+	bool copied = true;
+	struct dirent *entry;
+
+	while ( copied && ( entry = readdir( dir ) ) != NULL )
+	{
+		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
+			continue;
+
+		char fromPath[ TREE_CACHE_MAX_PATH ];
+		char toPath[ TREE_CACHE_MAX_PATH ];
+
+		if ( entry->d_type == DT_DIR )
+		{
+			string_utf8_format( fromPath, "%s%s/", from, entry->d_name );
+			string_utf8_format( toPath, "%s%s/", to, entry->d_name );
+
+			copied = tree_cache_copy( fromPath, toPath, rootBytes, link, ownFiles, ownFileCount, links );
+		}
+		else
+		{
+			string_utf8_format( fromPath, "%s%s", from, entry->d_name );
+			string_utf8_format( toPath, "%s%s", to, entry->d_name );
+
+			bool own = false;
+
+			for ( u64 i = 0; i < ownFileCount && !own; ++i )
+				own = string_utf8_compare( toPath + rootBytes, ownFiles[ i ] );
+
+			copied = tree_cache_make_file( fromPath, toPath, link, own, links );
+
+			if ( !copied )
+				log_error( "Failed to copy %s to %s", fromPath, toPath );
+		}
+	}
+
+	closedir( dir );
+
+	return copied;
+}
+
+bool tree_cache_store( const char *cacheFolder, const char *commitId, const char *extractedFolder )
+{
+	// Each store builds in a folder of its own, named for the process and a count within it.
+	// Another thread or run storing the same commit never writes into it, nor removes it.
+	static std::atomic<u64> stores = 0;
+
+	char path[ TREE_CACHE_MAX_PATH ];
+	char tempPath[ TREE_CACHE_MAX_PATH ];
+
+	tree_cache_path( cacheFolder, commitId, path, sizeof( path ) );
+	string_utf8_format( tempPath, "%s%s%s.%llu.%llu.tmp/", cacheFolder, TREE_CACHE_FOLDER, commitId, (unsigned long long)process_id(),
+		(unsigned long long)stores.fetch_add( 1 ) );
+
+	// Cloned, the project keeps the extracted files and the cache shares their blocks where it can
+	TreeCacheLinks links = {};
+
+	if ( !tree_cache_copy( extractedFolder, tempPath, string_utf8_bytes( tempPath ) - 1, TREE_LINK_CLONE, nullptr, 0, &links ) )
+	{
+		delete_directory( tempPath );
+		return false;
+	}
+
+	// rename wants the folders without their trailing separator
+	path[ string_utf8_bytes( path ) - 2 ] = '\0';
+	tempPath[ string_utf8_bytes( tempPath ) - 2 ] = '\0';
+
+	// Another thread or run may have cached the same commit meanwhile, theirs is kept and this one counts as stored
+	if ( rename( tempPath, path ) != 0 )
+	{
+		delete_directory( tempPath );
+		return tree_cache_find( cacheFolder, commitId );
+	}
+
+	return true;
+}
+
+bool tree_cache_instantiate( const char *cacheFolder, const char *commitId, const char *destFolder, TREE_LINK link, const char *const *ownFiles, u64 ownFileCount, TreeCacheLinks *links )
+{
+	char path[ TREE_CACHE_MAX_PATH ];
+	tree_cache_path( cacheFolder, commitId, path, sizeof( path ) );
+
+	*links = {};
+
+	return tree_cache_copy( path, destFolder, string_utf8_bytes( destFolder ) - 1, link, ownFiles, ownFileCount, links );
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#define TREE_CACHE_MAX_PATH			( 4096 )
+#define TREE_CACHE_MAX_ID			( 65 )
+#define TREE_CACHE_FOLDER			"trees/"
+
+// How the files of a cached tree are made in a project
+enum TREE_LINK
+{
+	TREE_LINK_COPY,			// Every byte is copied
+	TREE_LINK_CLONE,		// The cached blocks are shared where the filesystem can clone them, copied otherwise
+	TREE_LINK_HARDLINK,		// Cloned, otherwise hard linked to the cached file, except those that will be changed
+};
+
+// How many files of a tree were made each way
+struct TreeCacheLinks
+{
+	u64 shared;
+	u64 linked;
+	u64 copied;
+};
+
+// Reads the commit id a GitHub archive carries as its comment, 40 ( sha1 ) or 64 ( sha256 ) hex digits
+// @return false if the comment is not a commit id
+bool tree_cache_commit_id( const char *comment, u64 length, char *commitId );
+
+// Path of the extracted tree for a commit, <cache>/trees/<commit>/
+void tree_cache_path( const char *cacheFolder, const char *commitId, char *path, u64 maxPath );
+
+// @return true if the tree of the commit has been cached
+bool tree_cache_find( const char *cacheFolder, const char *commitId );
+
+// Copies an extracted tree into the cache, under its commit id
+// Built in a temporary folder and renamed into place, a partial tree is never found
+bool tree_cache_store( const char *cacheFolder, const char *commitId, const char *extractedFolder );
+
+// Makes the cached tree of a commit in destFolder. ownFiles, paths relative to it, are always given their own copy,
+// they are rewritten afterwards and must not write through a hard link into the cache.
+bool tree_cache_instantiate( const char *cacheFolder, const char *commitId, const char *destFolder, TREE_LINK link, const char *const *ownFiles, u64 ownFileCount, TreeCacheLinks *links );
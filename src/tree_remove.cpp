@@ -0,0 +1,262 @@
+// TREE REMOVE //////////////////////////////////////////////////////////////////////////
+#ifdef PLATFORM_WINDOWS
+
+// One pass over each folder, its subfolders are emptied and removed as they are found
+static void tree_remove_path( TreeRemove *tr, const char *path )
+{
+	DIR *dir = opendir( path );
+	if ( !dir )
+	{
+		tr->failed.fetch_add( 1 );
+		return;
+	}
+
+	struct dirent *entry;
+
+	while ( ( entry = readdir( dir ) ) != NULL )
+	{
+		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
+			continue;
+
+		char childPath[ MAX_FILEPATH ];
+		string_utf8_format( childPath, "%s/%s", path, entry->d_name );
+
+		if ( entry->d_type == DT_DIR )
+		{
+			tree_remove_path( tr, childPath );
+
+			if ( _rmdir( childPath ) == 0 )
+				tr->removed.fetch_add( 1 );
+			else
+				tr->failed.fetch_add( 1 );
+		}
+		else if ( _unlink( childPath ) == 0 )
+		{
+			tr->removed.fetch_add( 1 );
+		}
+		else
+		{
+			tr->failed.fetch_add( 1 );
+		}
+	}
+
+	closedir( dir );
+}
+
+bool tree_remove( const char *path, u64 threads, u64 *removed )
+{
+	*removed = 0;
+
+	DIR *dir = opendir( path );
+	if ( !dir )
+		return false;
+
+	closedir( dir );
+
+	TreeRemove tr = {};
+	tree_remove_path( &tr, path );
+
+	bool deleted = _rmdir( path ) == 0;
+	*removed = tr.removed + ( deleted ? 1 : 0 );
+
+	return deleted;
+}
+
+#else
+
+static void tree_remove_folder( TreeRemove *tr, i32 fd );
+
+// Hands a subfolder over when a thread is idle and nothing is already waiting for it
+static bool tree_remove_give( TreeRemove *tr, i32 parentFd, std::atomic<u64> *pending, const char *name )
+{
+	if ( tr->idle.load() == 0 )
+		return false;
+
+	u64 bytes = string_utf8_bytes( name );
+	if ( bytes > TREE_REMOVE_MAX_NAME )
+		return false;
+
+	bool given;
+
+	{
+		std::lock_guard<std::mutex> lock( tr->lock );
+
+		given = tr->taskCount < TREE_REMOVE_MAX_TASKS && tr->taskCount < tr->idle.load();
+
+		if ( given )
+		{
+			TreeRemoveTask *task = &tr->tasks[ tr->taskCount++ ];
+			task->parentFd = parentFd;
+			task->pending = pending;
+			string_utf8_copy( task->name, name );
+
+			pending->fetch_add( 1 );
+		}
+	}
+
+	if ( given )
+		tr->wake.notify_one();
+
+	return given;
+}
+
+// Empties a subfolder then removes it from its parent
+static void tree_remove_subfolder( TreeRemove *tr, i32 parentFd, const char *name )
+{
+	i32 fd = openat( parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+
+	if ( fd < 0 )
+	{
+		// Gone already
+		if ( errno != ENOENT )
+			tr->failed.fetch_add( 1 );
+
+		return;
+	}
+
+	tree_remove_folder( tr, fd );
+
+	if ( unlinkat( parentFd, name, AT_REMOVEDIR ) == 0 )
+		tr->removed.fetch_add( 1 );
+	else
+		tr->failed.fetch_add( 1 );
+}
+
+static void tree_remove_run( TreeRemove *tr, const TreeRemoveTask *task )
+{
+	tree_remove_subfolder( tr, task->parentFd, task->name );
+
+	// Under the lock, so the parent's thread can't see 0, close its folder and return, before it is woken
+	{
+		std::lock_guard<std::mutex> lock( tr->lock );
+		task->pending->fetch_sub( 1 );
+	}
+
+	tr->wake.notify_all();
+}
+
+// Empties the folder open at fd, and closes it
+static void tree_remove_folder( TreeRemove *tr, i32 fd )
+{
+	DIR *dir = fdopendir( fd );
+	if ( !dir )
+	{
+		close( fd );
+		tr->failed.fetch_add( 1 );
+		return;
+	}
+
+	std::atomic<u64> pending = 0;
+	struct dirent *entry;
+
+	while ( ( entry = readdir( dir ) ) != NULL )
+	{
+		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
+			continue;
+
+		bool folder = entry->d_type == DT_DIR;
+
+		// Not every filesystem fills in the type
+		if ( entry->d_type == DT_UNKNOWN )
+		{
+			struct stat st;
+			folder = fstatat( fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW ) == 0 && S_ISDIR( st.st_mode );
+		}
+
+		if ( !folder )
+		{
+			if ( unlinkat( fd, entry->d_name, 0 ) == 0 )
+				tr->removed.fetch_add( 1 );
+			else
+				tr->failed.fetch_add( 1 );
+		}
+		else if ( !tree_remove_give( tr, fd, &pending, entry->d_name ) )
+		{
+			tree_remove_subfolder( tr, fd, entry->d_name );
+		}
+	}
+
+	// The subfolders handed over are removed through this folder's fd, help with whatever is waiting meanwhile
+	if ( pending.load() > 0 )
+	{
+		std::unique_lock<std::mutex> lock( tr->lock );
+
+		while ( pending.load() > 0 )
+		{
+			if ( tr->taskCount > 0 )
+			{
+				TreeRemoveTask task = tr->tasks[ --tr->taskCount ];
+
+				lock.unlock();
+				tree_remove_run( tr, &task );
+				lock.lock();
+			}
+			else
+			{
+				tr->wake.wait( lock );
+			}
+		}
+	}
+
+	closedir( dir );
+}
+
+static void tree_remove_worker( TreeRemove *tr )
+{
+	std::unique_lock<std::mutex> lock( tr->lock );
+
+	tr->idle.fetch_add( 1 );
+
+	for ( ;; )
+	{
+		tr->wake.wait( lock, [ tr ]() { return tr->taskCount > 0 || tr->done; } );
+
+		if ( tr->taskCount == 0 )
+			return;
+
+		TreeRemoveTask task = tr->tasks[ --tr->taskCount ];
+		tr->idle.fetch_sub( 1 );
+
+		lock.unlock();
+		tree_remove_run( tr, &task );
+		lock.lock();
+
+		tr->idle.fetch_add( 1 );
+	}
+}
+
+bool tree_remove( const char *path, u64 threads, u64 *removed )
+{
+	*removed = 0;
+
+	i32 fd = open( path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+	if ( fd < 0 )
+		return false;
+
+	TreeRemove tr = {};
+	std::thread workers[ TREE_REMOVE_MAX_THREADS ];
+	u64 started = 0;
+
+	for ( ; started + 1 < min<u64>( threads, TREE_REMOVE_MAX_THREADS ); ++started )
+		workers[ started ] = std::thread( tree_remove_worker, &tr );
+
+	// Returns once every subfolder handed over is done, so nothing is left for the workers
+	tree_remove_folder( &tr, fd );
+
+	{
+		std::lock_guard<std::mutex> lock( tr.lock );
+		tr.done = true;
+	}
+
+	tr.wake.notify_all();
+
+	for ( u64 i = 0; i < started; ++i )
+		workers[ i ].join();
+
+	bool deleted = rmdir( path ) == 0;
+	*removed = tr.removed + ( deleted ? 1 : 0 );
+
+	return deleted;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#define TREE_REMOVE_MAX_THREADS			( 64 )
+#define TREE_REMOVE_MAX_TASKS			( 64 )
+#define TREE_REMOVE_MAX_NAME			( 256 )
+
+// A subfolder handed to an idle thread, which removes it from its parent once it is empty.
+// The parent's thread keeps parentFd open until every subfolder it handed over is done.
+struct TreeRemoveTask
+{
+	i32 parentFd;
+	std::atomic<u64> *pending;
+	char name[ TREE_REMOVE_MAX_NAME ];
+};
+
+// Each thread walks folders depth first on its own stack, reading each folder once and removing entries relative to its fd.
+// A subfolder is only handed over while another thread is idle, waiting for one to take.
+// Idle threads, and those waiting on the subfolders they handed over, sleep on wake until there is a task or they are done.
+struct TreeRemove
+{
+	std::mutex lock;
+	std::condition_variable wake;
+	TreeRemoveTask tasks[ TREE_REMOVE_MAX_TASKS ];
+	u64 taskCount;
+	bool done;
+
+	// Read without the lock to skip it when no thread is waiting, only changed with it
+	std::atomic<u64> idle;
+
+	std::atomic<u64> removed;
+	std::atomic<u64> failed;
+};
+
+// Removes a folder and everything in it, symbolic links are removed rather than followed
+// @param removed the files and folders removed, the folder itself included
+// @return false if the folder is not there or could not be removed
+bool tree_remove( const char *path, u64 threads, u64 *removed );
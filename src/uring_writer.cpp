@@ -0,0 +1,309 @@
+// URING WRITER /////////////////////////////////////////////////////////////////////////
+#ifdef PLATFORM_LINUX
+
+#define URING_WRITER_RING_ENTRIES		( 256 )
+
+// What each of a file's linked requests is, kept in the low bits of its user data
+enum URING_OP
+{
+	URING_OP_OPEN,
+	URING_OP_WRITE,
+	URING_OP_SYNC,
+	URING_OP_CLOSE,
+	URING_OP_COUNT,
+};
+
+// A full batch is queued before it is submitted
+static_assert( URING_WRITER_MAX_FILES * URING_OP_COUNT <= URING_WRITER_RING_ENTRIES, "A batch does not fit in the ring" );
+
+static i32 uring_setup( u32 entries, io_uring_params *params )
+{
+	return static_cast<i32>( syscall( __NR_io_uring_setup, entries, params ) );
+}
+
+static i32 uring_enter( i32 fd, u32 submit, u32 wait, u32 flags )
+{
+	return static_cast<i32>( syscall( __NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0 ) );
+}
+
+static i32 uring_register( i32 fd, u32 opcode, void *arg, u32 count )
+{
+	return static_cast<i32>( syscall( __NR_io_uring_register, fd, opcode, arg, count ) );
+}
+
+// Every operation a file takes, and opening into a registered slot
+static bool uring_writer_probe( i32 ringFd, bool sync )
+{
+	u8 memory[ sizeof( io_uring_probe ) + 256 * sizeof( io_uring_probe_op ) ] = {};
+	io_uring_probe *probe = (io_uring_probe *)memory;
+
+	if ( uring_register( ringFd, IORING_REGISTER_PROBE, probe, 256 ) < 0 )
+		return false;
+
+	// Opening into a slot came with 5.15, as did LINKAT. Before that the slot is ignored and a plain fd returned.
+	if ( probe->last_op < IORING_OP_LINKAT )
+		return false;
+
+	u8 ops[] = { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE, sync ? (u8)IORING_OP_FSYNC : (u8)IORING_OP_CLOSE };
+
+	for ( u8 op : ops )
+	{
+		if ( op > probe->last_op || !( probe->ops[ op ].flags & IO_URING_OP_SUPPORTED ) )
+			return false;
+	}
+
+	// Empty slots for the files to be opened into
+	i32 fds[ URING_WRITER_MAX_FILES ];
+
+	for ( i32 &fd : fds )
+		fd = -1;
+
+	return uring_register( ringFd, IORING_REGISTER_FILES, fds, URING_WRITER_MAX_FILES ) == 0;
+}
+
+bool uring_writer_begin( UringWriter *writer, u8 *buffer, u64 bufferSize, bool sync )
+{
+	*writer = {};
+	writer->ringFd = -1;
+	writer->buffer = buffer;
+	writer->bufferSize = bufferSize;
+	writer->sync = sync;
+
+	io_uring_params params = {};
+	i32 fd = uring_setup( URING_WRITER_RING_ENTRIES, &params );
+
+	if ( fd < 0 )
+		return false;
+
+	writer->ringFd = fd;
+	writer->sqRingSize = params.sq_off.array + params.sq_entries * sizeof( u32 );
+	writer->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+	writer->sqesSize = params.sq_entries * sizeof( io_uring_sqe );
+
+	// Newer kernels put both rings in one mapping
+	if ( params.features & IORING_FEAT_SINGLE_MMAP )
+		writer->sqRingSize = writer->cqRingSize = max( writer->sqRingSize, writer->cqRingSize );
+
+	void *sqRing = mmap( nullptr, writer->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+	void *cqRing = sqRing;
+
+	if ( sqRing != MAP_FAILED && !( params.features & IORING_FEAT_SINGLE_MMAP ) )
+		cqRing = mmap( nullptr, writer->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+
+	void *sqes = sqRing != MAP_FAILED && cqRing != MAP_FAILED ?
+		mmap( nullptr, writer->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES ) : MAP_FAILED;
+
+	writer->sqRing = sqRing != MAP_FAILED ? (u8 *)sqRing : nullptr;
+	writer->cqRing = cqRing != MAP_FAILED ? (u8 *)cqRing : nullptr;
+	writer->sqes = sqes != MAP_FAILED ? sqes : nullptr;
+
+	if ( !writer->sqRing || !writer->cqRing || !writer->sqes || !uring_writer_probe( fd, sync ) )
+	{
+		uring_writer_end( writer );
+		return false;
+	}
+
+	writer->sqHead = (u32 *)( writer->sqRing + params.sq_off.head );
+	writer->sqTail = (u32 *)( writer->sqRing + params.sq_off.tail );
+	writer->sqArray = (u32 *)( writer->sqRing + params.sq_off.array );
+	writer->sqMask = *(u32 *)( writer->sqRing + params.sq_off.ring_mask );
+	writer->sqEntries = params.sq_entries;
+
+	writer->cqHead = (u32 *)( writer->cqRing + params.cq_off.head );
+	writer->cqTail = (u32 *)( writer->cqRing + params.cq_off.tail );
+	writer->cqMask = *(u32 *)( writer->cqRing + params.cq_off.ring_mask );
+	writer->cqes = writer->cqRing + params.cq_off.cqes;
+
+	return true;
+}
+
+void uring_writer_end( UringWriter *writer )
+{
+	if ( writer->sqes )
+		munmap( writer->sqes, writer->sqesSize );
+	if ( writer->cqRing && writer->cqRing != writer->sqRing )
+		munmap( writer->cqRing, writer->cqRingSize );
+	if ( writer->sqRing )
+		munmap( writer->sqRing, writer->sqRingSize );
+
+	// Closing the ring closes whatever is left in its registered slots
+	if ( writer->ringFd >= 0 )
+		close( writer->ringFd );
+
+	*writer = {};
+	writer->ringFd = -1;
+}
+
+bool uring_writer_room( const UringWriter *writer, u64 size, u64 nameBytes )
+{
+	return writer->fileCount < URING_WRITER_MAX_FILES && size <= URING_WRITER_MAX_FILE_SIZE && writer->bufferUsed + size + nameBytes + 1 <= writer->bufferSize;
+}
+
+u8 *uring_writer_reserve( UringWriter *writer, u64 size )
+{
+	u8 *data = writer->buffer + writer->bufferUsed;
+	writer->bufferUsed += size;
+
+	return data;
+}
+
+static io_uring_sqe *uring_writer_sqe( UringWriter *writer, u8 opcode, u64 file, URING_OP op )
+{
+	u32 tail = *writer->sqTail + writer->queued;
+	u32 index = tail & writer->sqMask;
+
+	io_uring_sqe *sqe = (io_uring_sqe *)writer->sqes + index;
+	*sqe = {};
+	sqe->opcode = opcode;
+	sqe->user_data = file * URING_OP_COUNT + op;
+
+	writer->sqArray[ index ] = index;
+	writer->queued += 1;
+
+	return sqe;
+}
+
+void uring_writer_add( UringWriter *writer, i32 dirFd, const char *name, u64 nameBytes, const u8 *data, u64 size, u64 user )
+{
+	// The name is read when the open runs, after this returns
+	char *path = (char *)uring_writer_reserve( writer, nameBytes + 1 );
+	string_utf8_copy( path, nameBytes + 1, name, nameBytes );
+
+	u64 file = writer->fileCount++;
+	writer->files[ file ] = { .user = user, .size = static_cast<u32>( size ), .failed = false };
+
+	// The write, fsync and close only run once the one before succeeds, a failed open cancels the rest.
+	// Opened into a slot rather than as a descriptor, which the kernel won't do with O_CLOEXEC.
+	io_uring_sqe *sqe = uring_writer_sqe( writer, IORING_OP_OPENAT, file, URING_OP_OPEN );
+	sqe->fd = dirFd;
+	sqe->addr = (u64)path;
+	sqe->len = 0666;
+	sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+	sqe->file_index = static_cast<u32>( file + 1 );
+	sqe->flags = IOSQE_IO_LINK;
+
+	sqe = uring_writer_sqe( writer, IORING_OP_WRITE, file, URING_OP_WRITE );
+	sqe->fd = static_cast<i32>( file );
+	sqe->addr = (u64)data;
+	sqe->len = static_cast<u32>( size );
+	sqe->off = 0;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+
+	if ( writer->sync )
+	{
+		sqe = uring_writer_sqe( writer, IORING_OP_FSYNC, file, URING_OP_SYNC );
+		sqe->fd = static_cast<i32>( file );
+		sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+	}
+
+	sqe = uring_writer_sqe( writer, IORING_OP_CLOSE, file, URING_OP_CLOSE );
+	sqe->file_index = static_cast<u32>( file + 1 );
+}
+
+u64 uring_writer_flush( UringWriter *writer )
+{
+	if ( writer->queued == 0 )
+		return 0;
+
+	// The kernel sees the requests once the tail moves past them
+	std::atomic_ref<u32>( *writer->sqTail ).store( *writer->sqTail + writer->queued, std::memory_order_release );
+
+	u32 submit = writer->queued;
+	u32 remaining = writer->queued;
+	u64 failed = 0;
+
+	writer->queued = 0;
+
+	while ( remaining > 0 )
+	{
+		i32 result = uring_enter( writer->ringFd, submit, remaining, IORING_ENTER_GETEVENTS );
+
+		if ( result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+		{
+			// Nothing more will complete, whatever hasn't is written another way
+			for ( u64 i = 0; i < writer->fileCount; ++i )
+				writer->files[ i ].failed = true;
+
+			return writer->fileCount;
+		}
+
+		if ( result > 0 )
+			submit -= min<u32>( submit, static_cast<u32>( result ) );
+
+		u32 head = *writer->cqHead;
+		u32 tail = std::atomic_ref<u32>( *writer->cqTail ).load( std::memory_order_acquire );
+
+		for ( ; head != tail; ++head, --remaining )
+		{
+			const io_uring_cqe *cqe = (const io_uring_cqe *)writer->cqes + ( head & writer->cqMask );
+
+			UringFile *file = &writer->files[ cqe->user_data / URING_OP_COUNT ];
+			u64 op = cqe->user_data % URING_OP_COUNT;
+
+			// A short write is a failure too, it leaves the file incomplete
+			bool ok = op == URING_OP_WRITE ? cqe->res == static_cast<i32>( file->size ) : cqe->res >= 0;
+
+			// Opened into a slot the result is 0, a kernel that ignored the slot handed back a descriptor nothing else will close
+			if ( op == URING_OP_OPEN && cqe->res > 0 )
+			{
+				close( cqe->res );
+				ok = false;
+			}
+
+			if ( !ok && !file->failed )
+			{
+				file->failed = true;
+				failed += 1;
+			}
+		}
+
+		std::atomic_ref<u32>( *writer->cqHead ).store( head, std::memory_order_release );
+	}
+
+	return failed;
+}
+
+void uring_writer_reset( UringWriter *writer )
+{
+	writer->fileCount = 0;
+	writer->bufferUsed = 0;
+}
+
+#else
+
+bool uring_writer_begin( UringWriter *writer, u8 *buffer, u64 bufferSize, bool sync )
+{
+	*writer = {};
+	writer->ringFd = -1;
+
+	return false;
+}
+
+void uring_writer_end( UringWriter *writer )
+{
+}
+
+bool uring_writer_room( const UringWriter *writer, u64 size, u64 nameBytes )
+{
+	return false;
+}
+
+u8 *uring_writer_reserve( UringWriter *writer, u64 size )
+{
+	return nullptr;
+}
+
+void uring_writer_add( UringWriter *writer, i32 dirFd, const char *name, u64 nameBytes, const u8 *data, u64 size, u64 user )
+{
+}
+
+u64 uring_writer_flush( UringWriter *writer )
+{
+	return 0;
+}
+
+void uring_writer_reset( UringWriter *writer )
+{
+}
+
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+#define URING_WRITER_MAX_FILES			( 64 )
+#define URING_WRITER_MAX_FILE_SIZE		( KB( 64 ) )
+
+// A file queued to be written, failed is set once the batch it is in has been flushed
+struct UringFile
+{
+	u64 user;
+	u32 size;
+	bool failed;
+};
+
+// Writes whole files through io_uring, each as an openat, write and close linked together, a batch of them submitted at once.
+// When syncing, an fsync is linked in between the write and the close.
+// The files are opened into registered slots so the write and close can follow the open without waiting for its result.
+// Names and data are kept in a buffer the caller gives it, they must stay there until the batch is flushed.
+// One thread uses a writer at a time, it can be set up on one thread and used on another.
+struct UringWriter
+{
+	i32 ringFd;
+
+	u8 *sqRing;
+	u64 sqRingSize;
+	u32 *sqHead;
+	u32 *sqTail;
+	u32 *sqArray;
+	u32 sqMask;
+	u32 sqEntries;
+	void *sqes;
+	u64 sqesSize;
+
+	u8 *cqRing;
+	u64 cqRingSize;
+	u32 *cqHead;
+	u32 *cqTail;
+	u32 cqMask;
+	void *cqes;
+
+	u32 queued;
+	bool sync;
+
+	UringFile files[ URING_WRITER_MAX_FILES ];
+	u64 fileCount;
+
+	u8 *buffer;
+	u64 bufferSize;
+	u64 bufferUsed;
+};
+
+// @param sync whether each file is flushed to the disk before it is closed
+// @return false if the kernel has no io_uring, or not the operations it needs, the caller writes files another way
+bool uring_writer_begin( UringWriter *writer, u8 *buffer, u64 bufferSize, bool sync );
+void uring_writer_end( UringWriter *writer );
+
+// @return true if a file of the given size and name fits in the batch, otherwise flush it first
+[[nodiscard]] bool uring_writer_room( const UringWriter *writer, u64 size, u64 nameBytes );
+
+// Space in the buffer for a file's data, call uring_writer_room first
+[[nodiscard]] u8 *uring_writer_reserve( UringWriter *writer, u64 size );
+
+// Queues a file to be created, relative to dirFd, with the given data. user is handed back when it fails.
+void uring_writer_add( UringWriter *writer, i32 dirFd, const char *name, u64 nameBytes, const u8 *data, u64 size, u64 user );
+
+// Submits the batch and waits for all of it, the files that failed are marked
+// @return the number of files that failed
+u64 uring_writer_flush( UringWriter *writer );
+
+// Empties the batch once the failures have been dealt with
+void uring_writer_reset( UringWriter *writer );
@@ -406,4 +406,287 @@ u64 convert_to_string( char *dest, u64 destSize, bool value )
 	convert_to_string( text, MAX_CONVERT_TO_STRING_DIGITS, value );
 	allocator->shrink( text, string_utf8_bytes( text ) );
 	return text;
-}
\ No newline at end of file
+}
+
+[[nodiscard]] u64 time_now_ms()
+{
+	#ifdef PLATFORM_WINDOWS
+		return GetTickCount64();
+	#else
+		struct timespec now;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		return static_cast<u64>( now.tv_sec ) * 1000 + static_cast<u64>( now.tv_nsec ) / 1000000;
+	#endif
+}
+
+[[nodiscard]] u64 time_now_us()
+{
+	#ifdef PLATFORM_WINDOWS
+		LARGE_INTEGER now, frequency;
+		QueryPerformanceCounter( &now );
+		QueryPerformanceFrequency( &frequency );
+		return static_cast<u64>( now.QuadPart / frequency.QuadPart ) * 1000000 + static_cast<u64>( now.QuadPart % frequency.QuadPart ) * 1000000 / static_cast<u64>( frequency.QuadPart );
+	#else
+		struct timespec now;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		return static_cast<u64>( now.tv_sec ) * 1000000 + static_cast<u64>( now.tv_nsec ) / 1000;
+	#endif
+}
+
+void sleep_ms( u64 ms )
+{
+	#ifdef PLATFORM_WINDOWS
+		Sleep( static_cast<DWORD>( ms ) );
+	#else
+		struct timespec duration;
+		duration.tv_sec = static_cast<time_t>( ms / 1000 );
+		duration.tv_nsec = static_cast<long>( ( ms % 1000 ) * 1000000 );
+		while ( nanosleep( &duration, &duration ) != 0 )
+			;
+	#endif
+}
+
+[[nodiscard]] u64 time_wall_us()
+{
+	#ifdef PLATFORM_WINDOWS
+		FILETIME now;
+		GetSystemTimeAsFileTime( &now );
+		u64 ticks = ( static_cast<u64>( now.dwHighDateTime ) << 32 ) | now.dwLowDateTime;
+		return ( ticks - 116444736000000000ULL ) / 10;
+	#else
+		struct timespec now;
+		clock_gettime( CLOCK_REALTIME, &now );
+		return static_cast<u64>( now.tv_sec ) * 1000000 + static_cast<u64>( now.tv_nsec ) / 1000;
+	#endif
+}
+
+[[nodiscard]] u64 process_id()
+{
+	#ifdef PLATFORM_WINDOWS
+		return static_cast<u64>( GetCurrentProcessId() );
+	#else
+		return static_cast<u64>( getpid() );
+	#endif
+}
+
+[[nodiscard]] bool process_running( u64 id )
+{
+	#ifdef PLATFORM_WINDOWS
+		HANDLE process = OpenProcess( PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>( id ) );
+		if ( !process )
+			return GetLastError() == ERROR_ACCESS_DENIED;
+
+		DWORD exitCode = 0;
+		bool running = GetExitCodeProcess( process, &exitCode ) && exitCode == STILL_ACTIVE;
+		CloseHandle( process );
+		return running;
+	#else
+		return kill( static_cast<pid_t>( id ), 0 ) == 0 || errno == EPERM;
+	#endif
+}
+
+bool copy_file( const char *from, const char *to )
+{
+	FILE *src = fopen( from, "rb" );
+	if ( !src )
+		return false;
+
+	FILE *dst = fopen( to, "wb" );
+	if ( !dst )
+	{
+		fclose( src );
+		return false;
+	}
+
+	u8 buffer[ KB( 64 ) ];
+	u64 bytes;
+	bool copied = true;
+
+	while ( copied && ( bytes = fread( buffer, 1, sizeof( buffer ), src ) ) > 0 )
+		copied = fwrite( buffer, 1, bytes, dst ) == bytes;
+
+	if ( ferror( src ) )
+		copied = false;
+
+	fclose( src );
+
+	if ( fclose( dst ) != 0 )
+		copied = false;
+
+	if ( !copied )
+		remove( to );
+
+	return copied;
+}
+
+bool clone_file( const char *from, const char *to, bool copy, bool *shared )
+{
+	*shared = false;
+
+	#if defined( PLATFORM_WINDOWS )
+		return copy && copy_file( from, to );
+	#elif defined( PLATFORM_MAC )
+		// clonefile makes the destination itself, it won't replace one
+		remove( to );
+
+		if ( clonefile( from, to, 0 ) == 0 )
+		{
+			*shared = true;
+			return true;
+		}
+
+		return copy && copy_file( from, to );
+	#else
+		i32 src = open( from, O_RDONLY | O_CLOEXEC );
+		if ( src < 0 )
+			return false;
+
+		struct stat st;
+		i32 dst = fstat( src, &st ) == 0 ? open( to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666 ) : -1;
+
+		if ( dst < 0 )
+		{
+			close( src );
+			return false;
+		}
+
+		bool copied = ioctl( dst, FICLONE, src ) == 0;
+		*shared = copied;
+
+		if ( !copied && copy )
+		{
+			// Copied in the kernel, which may still share blocks, then through a buffer for whatever it couldn't.
+			// Both move the file offsets, the buffer carries on from where the kernel stopped.
+			u64 remaining = static_cast<u64>( st.st_size );
+			ssize_t bytes = 0;
+
+			while ( remaining > 0 && ( bytes = copy_file_range( src, nullptr, dst, nullptr, remaining, 0 ) ) > 0 )
+				remaining -= static_cast<u64>( bytes );
+
+			u8 buffer[ KB( 64 ) ];
+			copied = true;
+
+			while ( copied && ( bytes = read( src, buffer, sizeof( buffer ) ) ) > 0 )
+				copied = write( dst, buffer, static_cast<size_t>( bytes ) ) == bytes;
+
+			copied = copied && bytes == 0;
+		}
+
+		close( src );
+
+		if ( close( dst ) != 0 )
+			copied = false;
+
+		if ( !copied )
+			remove( to );
+
+		return copied;
+	#endif
+}
+
+bool link_file( const char *from, const char *to )
+{
+	#ifdef PLATFORM_WINDOWS
+		return CreateHardLinkA( to, from, nullptr ) != 0;
+	#else
+		return link( from, to ) == 0;
+	#endif
+}
+
+bool close_file( FILE *fp, bool sync )
+{
+	bool synced = true;
+
+	if ( sync )
+	{
+		synced = fflush( fp ) == 0;
+
+		#ifdef PLATFORM_WINDOWS
+			synced = synced && _commit( _fileno( fp ) ) == 0;
+		#else
+			synced = synced && fsync( fileno( fp ) ) == 0;
+		#endif
+	}
+
+	return fclose( fp ) == 0 && synced;
+}
+
+bool sync_folder( const char *path )
+{
+	#ifdef PLATFORM_WINDOWS
+		(void)path;
+		return true;
+	#else
+		i32 fd = open( path, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+		if ( fd < 0 )
+			return false;
+
+		bool synced = fsync( fd ) == 0;
+		close( fd );
+
+		return synced;
+	#endif
+}
+
+#ifndef PLATFORM_LINUX
+// Flushes each file under the folder, then the folder itself
+static bool sync_tree_walk( const char *path )
+{
+	DIR *dir = opendir( path );
+	if ( !dir )
+		return false;
+
+	bool synced = true;
+	struct dirent *entry;
+
+	while ( ( entry = readdir( dir ) ) != NULL )
+	{
+		if ( string_utf8_compare( entry->d_name, "." ) || string_utf8_compare( entry->d_name, ".." ) )
+			continue;
+
+		char childPath[ MAX_FILEPATH ];
+		string_utf8_format( childPath, "%s/%s", path, entry->d_name );
+
+		if ( entry->d_type == DT_DIR )
+		{
+			synced = sync_tree_walk( childPath ) && synced;
+			continue;
+		}
+
+		#ifdef PLATFORM_WINDOWS
+			// Flushing needs a handle that can write
+			i32 fd = _open( childPath, _O_RDWR | _O_BINARY );
+			synced = fd >= 0 && _commit( fd ) == 0 && synced;
+
+			if ( fd >= 0 )
+				_close( fd );
+		#else
+			i32 fd = open( childPath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+			synced = fd >= 0 && fsync( fd ) == 0 && synced;
+
+			if ( fd >= 0 )
+				close( fd );
+		#endif
+	}
+
+	closedir( dir );
+
+	return sync_folder( path ) && synced;
+}
+#endif
+
+bool sync_tree( const char *path )
+{
+	#ifdef PLATFORM_LINUX
+		i32 fd = open( path, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+		if ( fd < 0 )
+			return false;
+
+		bool synced = syncfs( fd ) == 0;
+		close( fd );
+
+		return synced;
+	#else
+		return sync_tree_walk( path );
+	#endif
+}
@@ -122,4 +122,57 @@ inline u64 convert_to_string( char *dest, u64 destSize, bool value );
 [[nodiscard]] const char *convert_to_string( i8 value, i32 radix = 10, i32 trailing = 0 );
 
 [[nodiscard]] const char *convert_to_string( f32 value, i32 fracDigits );
-[[nodiscard]] const char *convert_to_string( bool value );
\ No newline at end of file
+[[nodiscard]] const char *convert_to_string( bool value );
+
+// Milliseconds from a monotonic clock, only useful for measuring durations
+[[nodiscard]] u64 time_now_ms();
+
+// Microseconds from a monotonic clock, only useful for measuring durations
+[[nodiscard]] u64 time_now_us();
+void sleep_ms( u64 ms );
+
+// Microseconds since 1970 from the wall clock, unlike time_now_us it goes on from one boot to the next
+[[nodiscard]] u64 time_wall_us();
+
+// Id of this process, unique among those running at the same time
+[[nodiscard]] u64 process_id();
+
+// @return true if a process with the id is running, or can't be told apart from one that is
+[[nodiscard]] bool process_running( u64 id );
+
+// Archives of a repository put everything in one folder, named for the repository and branch, which is left out when extracting.
+// @return bytes of the first folder in an entry's name, with its separator, 0 if there is none
+[[nodiscard]] inline u64 archive_root_bytes( const char *name )
+{
+	const char *separator = strchr( name, '/' );
+	return separator ? static_cast<u64>( separator - name ) + 1 : 0;
+}
+
+// @return bytes at the start of name to leave out, those of the root folder when the entry is inside it
+[[nodiscard]] inline u64 archive_root_skip( const char *name, const char *root, u64 rootBytes )
+{
+	return rootBytes > 0 && strncmp( name, root, rootBytes ) == 0 ? rootBytes : 0;
+}
+
+// Copies a file's contents, replacing the destination
+bool copy_file( const char *from, const char *to );
+
+// Copies a file, sharing its blocks where the filesystem can clone them ( btrfs, XFS, APFS ), replacing the destination
+// @param copy whether the blocks are copied when they can't be shared, otherwise it fails
+// @param shared set when the copy shares the source's blocks, rather than having its own
+bool clone_file( const char *from, const char *to, bool copy, bool *shared );
+
+// Makes to another name for the same file as from, to must not exist
+bool link_file( const char *from, const char *to );
+
+// Closes a file, first flushing what was written to it to the disk when sync is set
+// @return false if it could not be written or flushed
+bool close_file( FILE *fp, bool sync );
+
+// Flushes a folder's entries to the disk, so the names made or renamed in it survive a crash.
+// Windows has no way to do this for a folder, its entries go with the files' own metadata.
+bool sync_folder( const char *path );
+
+// Flushes everything written under a folder to the disk in one go.
+// syncfs on Linux flushes the whole filesystem the folder is on, elsewhere each file and folder in it is flushed in turn.
+bool sync_tree( const char *path );
@@ -0,0 +1,375 @@
+// ZIP MAP //////////////////////////////////////////////////////////////////////////////
+// Replaces the fields marked as 0xFFFFFFFF with the values from a zip64 extra field, in the order they appear there
+static bool zip_map_read_zip64( const u8 *extra, u64 extraBytes, u64 *uncompressedSize, u64 *compressedSize, u64 *offset )
+{
+	while ( extraBytes >= 4 )
+	{
+		u16 id = read_u16_le( extra );
+		u16 size = read_u16_le( extra + 2 );
+
+		if ( 4 + (u64)size > extraBytes )
+			return false;
+
+		if ( id == ZIP_EXTRA_ZIP64 )
+		{
+			const u8 *p = extra + 4;
+			const u8 *end = p + size;
+			u64 *fields[] = { uncompressedSize, compressedSize, offset };
+
+			for ( u64 *field : fields )
+			{
+				if ( *field != 0xFFFFFFFF )
+					continue;
+
+				if ( p + 8 > end )
+					return false;
+
+				*field = read_u64_le( p );
+				p += 8;
+			}
+
+			return true;
+		}
+
+		extra += 4 + size;
+		extraBytes -= 4 + size;
+	}
+
+	return false;
+}
+
+static bool zip_map_read_directory( ZipMap *map )
+{
+	const u8 *data = map->data;
+	u64 size = map->size;
+
+	if ( size < 22 )
+		return false;
+
+	// The end record is last, followed only by a comment of up to 64 KB
+	u64 lowest = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+	u64 end = size - 22;
+
+	while ( read_u32_le( data + end ) != ZIP_SIGNATURE_END || end + 22 + read_u16_le( data + end + 20 ) > size )
+	{
+		if ( end == lowest )
+			return false;
+
+		--end;
+	}
+
+	u64 entryCount = read_u16_le( data + end + 10 );
+	u64 directorySize = read_u32_le( data + end + 12 );
+	u64 directoryOffset = read_u32_le( data + end + 16 );
+
+	map->comment = (const char *)data + end + 22;
+	map->commentBytes = read_u16_le( data + end + 20 );
+
+	if ( entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF )
+	{
+		if ( end < 20 || read_u32_le( data + end - 20 ) != ZIP_SIGNATURE_ZIP64_LOCATOR )
+			return false;
+
+		u64 zip64End = read_u64_le( data + end - 20 + 8 );
+
+		if ( zip64End > size - 56 || read_u32_le( data + zip64End ) != ZIP_SIGNATURE_ZIP64_END )
+			return false;
+
+		entryCount = read_u64_le( data + zip64End + 32 );
+		directorySize = read_u64_le( data + zip64End + 40 );
+		directoryOffset = read_u64_le( data + zip64End + 48 );
+	}
+
+	if ( directoryOffset > size || directorySize > size - directoryOffset || entryCount > directorySize / 46 )
+		return false;
+
+	// One allocation for every array, widest fields first so each stays aligned
+	u64 count = max<u64>( entryCount, 1 );
+	u8 *index = (u8 *)malloc( count * ( 4 * sizeof( u64 ) + sizeof( u32 ) + 3 * sizeof( u16 ) ) );
+	if ( !index )
+		return false;
+
+	map->localOffsets = (u64 *)index;
+	map->compressedSizes = map->localOffsets + count;
+	map->uncompressedSizes = map->compressedSizes + count;
+	map->nameOffsets = map->uncompressedSizes + count;
+	map->crcs = (u32 *)( map->nameOffsets + count );
+	map->methods = (u16 *)( map->crcs + count );
+	map->flags = map->methods + count;
+	map->nameBytes = map->flags + count;
+
+	const u8 *p = data + directoryOffset;
+	const u8 *directoryEnd = p + directorySize;
+
+	for ( u64 i = 0; i < entryCount; ++i )
+	{
+		if ( p + 46 > directoryEnd || read_u32_le( p ) != ZIP_SIGNATURE_CENTRAL_HEADER )
+			return false;
+
+		u16 nameBytes = read_u16_le( p + 28 );
+		u16 extraBytes = read_u16_le( p + 30 );
+		u16 commentBytes = read_u16_le( p + 32 );
+		u64 compressedSize = read_u32_le( p + 20 );
+		u64 uncompressedSize = read_u32_le( p + 24 );
+		u64 localOffset = read_u32_le( p + 42 );
+
+		if ( p + 46 + nameBytes + extraBytes + commentBytes > directoryEnd || nameBytes == 0 )
+			return false;
+
+		if ( ( compressedSize == 0xFFFFFFFF || uncompressedSize == 0xFFFFFFFF || localOffset == 0xFFFFFFFF ) &&
+			!zip_map_read_zip64( p + 46 + nameBytes, extraBytes, &uncompressedSize, &compressedSize, &localOffset ) )
+		{
+			return false;
+		}
+
+		map->localOffsets[ i ] = localOffset;
+		map->compressedSizes[ i ] = compressedSize;
+		map->uncompressedSizes[ i ] = uncompressedSize;
+		map->nameOffsets[ i ] = static_cast<u64>( p + 46 - data );
+		map->crcs[ i ] = read_u32_le( p + 16 );
+		map->methods[ i ] = read_u16_le( p + 10 );
+		map->flags[ i ] = read_u16_le( p + 8 );
+		map->nameBytes[ i ] = nameBytes;
+
+		p += 46 + nameBytes + extraBytes + commentBytes;
+	}
+
+	map->entryCount = entryCount;
+
+	return true;
+}
+
+bool zip_map_open_file( ZipMap *map, const char *path )
+{
+	*map = {};
+	map->fd = -1;
+
+	#ifdef PLATFORM_WINDOWS
+		HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if ( file == INVALID_HANDLE_VALUE )
+			return false;
+
+		map->fileHandle = file;
+
+		LARGE_INTEGER fileSize;
+		if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+		{
+			zip_map_close( map );
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( !mapping )
+		{
+			zip_map_close( map );
+			return false;
+		}
+
+		map->mappingHandle = mapping;
+		map->data = (const u8 *)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+		map->size = static_cast<u64>( fileSize.QuadPart );
+	#else
+		map->fd = open( path, O_RDONLY );
+		if ( map->fd < 0 )
+			return false;
+
+		struct stat st;
+		if ( fstat( map->fd, &st ) != 0 || st.st_size == 0 )
+		{
+			zip_map_close( map );
+			return false;
+		}
+
+		void *data = mmap( nullptr, static_cast<size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, map->fd, 0 );
+		map->data = data == MAP_FAILED ? nullptr : (const u8 *)data;
+		map->size = static_cast<u64>( st.st_size );
+	#endif
+
+	map->mapped = map->data != nullptr;
+
+	if ( !map->mapped || !zip_map_read_directory( map ) )
+	{
+		zip_map_close( map );
+		return false;
+	}
+
+	return true;
+}
+
+bool zip_map_open_memory( ZipMap *map, const u8 *data, u64 size )
+{
+	*map = {};
+	map->fd = -1;
+	map->data = data;
+	map->size = size;
+
+	if ( !zip_map_read_directory( map ) )
+	{
+		zip_map_close( map );
+		return false;
+	}
+
+	return true;
+}
+
+void zip_map_close( ZipMap *map )
+{
+	free( map->localOffsets );
+
+	#ifdef PLATFORM_WINDOWS
+		if ( map->mapped )
+			UnmapViewOfFile( map->data );
+		if ( map->mappingHandle )
+			CloseHandle( map->mappingHandle );
+		if ( map->fileHandle )
+			CloseHandle( map->fileHandle );
+	#else
+		if ( map->mapped )
+			munmap( (void *)map->data, static_cast<size_t>( map->size ) );
+		if ( map->fd >= 0 )
+			close( map->fd );
+	#endif
+
+	*map = {};
+	map->fd = -1;
+}
+
+// The data of an entry, after checking its local header
+static const u8 *zip_map_entry_data( const ZipMap *map, u64 index, u64 size )
+{
+	if ( index >= map->entryCount )
+		return nullptr;
+
+	u64 offset = map->localOffsets[ index ];
+
+	if ( offset > map->size || map->size - offset < 30 )
+		return nullptr;
+
+	const u8 *h = map->data + offset;
+
+	if ( read_u32_le( h ) != ZIP_SIGNATURE_LOCAL_HEADER || ( read_u16_le( h + 6 ) & ZIP_FLAG_ENCRYPTED ) )
+		return nullptr;
+
+	u64 dataOffset = offset + 30 + read_u16_le( h + 26 ) + read_u16_le( h + 28 );
+
+	if ( dataOffset > map->size || map->size - dataOffset < size )
+		return nullptr;
+
+	return map->data + dataOffset;
+}
+
+[[nodiscard]] const u8 *zip_map_stored_data( const ZipMap *map, u64 index, u64 size )
+{
+	if ( index >= map->entryCount || map->methods[ index ] != ZIP_CM_STORE )
+		return nullptr;
+
+	return zip_map_entry_data( map, index, size );
+}
+
+bool zip_map_extract( const ZipMap *map, u64 index, FILE *file, z_stream *inflater, bool *inflaterActive, u8 *buffer, u64 bufferSize )
+{
+	u64 compressedSize = map->compressedSizes[ index ];
+	u64 uncompressedSize = map->uncompressedSizes[ index ];
+	u16 method = map->methods[ index ];
+	i32 nameBytes = map->nameBytes[ index ];
+	const char *name = zip_map_name( map, index );
+
+	if ( ( map->flags[ index ] & ZIP_FLAG_ENCRYPTED ) || ( method != ZIP_CM_STORE && method != ZIP_CM_DEFLATE ) )
+	{
+		log_error( "Unsupported archive entry ( method %d ): %.*s", method, nameBytes, name );
+		return false;
+	}
+
+	const u8 *data = zip_map_entry_data( map, index, compressedSize );
+	if ( !data )
+	{
+		log_error( "Archive entry data is not where its header says: %.*s", nameBytes, name );
+		return false;
+	}
+
+	u32 crc = crc32( 0, nullptr, 0 );
+	u64 written = 0;
+
+	if ( method == ZIP_CM_STORE )
+	{
+		crc = crc32_z( crc, data, compressedSize );
+
+		if ( file )
+		{
+			written = fwrite( data, 1, compressedSize, file );
+		}
+		else if ( compressedSize <= bufferSize )
+		{
+			memcpy( buffer, data, compressedSize );
+			written = compressedSize;
+		}
+	}
+	else
+	{
+		i32 result = *inflaterActive ? inflateReset( inflater ) : inflateInit2( inflater, -MAX_WBITS );
+		if ( result != Z_OK )
+		{
+			log_error( "Failed to initialise inflate for: %.*s", nameBytes, name );
+			return false;
+		}
+
+		*inflaterActive = true;
+
+		u64 remaining = compressedSize;
+		u64 outputSize = min( bufferSize, (u64)UINT32_MAX );
+
+		inflater->avail_in = 0;
+		inflater->next_out = buffer;
+		inflater->avail_out = static_cast<uInt>( outputSize );
+
+		while ( result != Z_STREAM_END )
+		{
+			// Inflate takes at most 4 GB at a time
+			if ( inflater->avail_in == 0 && remaining > 0 )
+			{
+				u64 take = min( remaining, (u64)UINT32_MAX );
+				inflater->next_in = (Bytef *)data + ( compressedSize - remaining );
+				inflater->avail_in = static_cast<uInt>( take );
+				remaining -= take;
+			}
+
+			result = inflate( inflater, Z_NO_FLUSH );
+
+			if ( result != Z_OK && result != Z_STREAM_END )
+			{
+				log_error( "Failed to inflate archive entry: %.*s", nameBytes, name );
+				return false;
+			}
+
+			// The buffer is only written once full, an entry that fits takes one write
+			if ( inflater->avail_out == 0 || result == Z_STREAM_END )
+			{
+				u64 produced = outputSize - inflater->avail_out;
+
+				// Without a file the whole entry has to fit
+				if ( file ? fwrite( buffer, 1, produced, file ) != produced : result != Z_STREAM_END )
+					break;
+
+				crc = crc32_z( crc, buffer, produced );
+
+				written += produced;
+				inflater->next_out = buffer;
+				inflater->avail_out = static_cast<uInt>( outputSize );
+			}
+		}
+	}
+
+	if ( written != uncompressedSize )
+	{
+		log_error( "Size mismatch for archive entry: %.*s", nameBytes, name );
+		return false;
+	}
+
+	if ( crc != map->crcs[ index ] )
+	{
+		log_error( "CRC mismatch for archive entry: %.*s", nameBytes, name );
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// A zip archive mapped into memory, from a file or a buffer already in memory, with its central directory read into an index.
+// Entries are numbered in central directory order, the same as libzip numbers them.
+// Read only once opened, so it can be shared by every thread extracting the archive.
+struct ZipMap
+{
+	const u8 *data;
+	u64 size;
+
+	// The open archive file, -1 for an archive in memory
+	i32 fd;
+	void *fileHandle;
+	void *mappingHandle;
+	bool mapped;
+
+	const char *comment;
+	u16 commentBytes;
+
+	// The central directory, one array per field so a pass over one of them touches nothing else.
+	// Names are not copied, they point into the mapping and are not null terminated.
+	// On the heap, there is one of each for every entry however many the archive has.
+	u64 entryCount;
+	u64 *localOffsets;
+	u64 *compressedSizes;
+	u64 *uncompressedSizes;
+	u64 *nameOffsets;
+	u32 *crcs;
+	u16 *methods;
+	u16 *flags;
+	u16 *nameBytes;
+};
+
+bool zip_map_open_file( ZipMap *map, const char *path );
+bool zip_map_open_memory( ZipMap *map, const u8 *data, u64 size );
+void zip_map_close( ZipMap *map );
+
+[[nodiscard]] inline const char *zip_map_name( const ZipMap *map, u64 index )
+{
+	return (const char *)map->data + map->nameOffsets[ index ];
+}
+
+[[nodiscard]] inline bool zip_map_is_folder( const ZipMap *map, u64 index )
+{
+	return map->nameBytes[ index ] > 0 && zip_map_name( map, index )[ map->nameBytes[ index ] - 1 ] == '/';
+}
+
+// The data of a stored, unencrypted entry, after checking its local header
+// @return nullptr if the entry is not stored or its data is not where it should be
+[[nodiscard]] const u8 *zip_map_stored_data( const ZipMap *map, u64 index, u64 size );
+
+// Inflates, or copies, an entry from the mapping to a file, through a buffer that is filled before each write.
+// Without a file the entry is left in the buffer, which must be bigger than the entry.
+// The inflater is reused between entries, start it zeroed and end it with inflateEnd once the thread is done.
+bool zip_map_extract( const ZipMap *map, u64 index, FILE *file, z_stream *inflater, bool *inflaterActive, u8 *buffer, u64 bufferSize );
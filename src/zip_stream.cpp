@@ -0,0 +1,580 @@
+// ZIP STREAM ///////////////////////////////////////////////////////////////////////////
+static bool zip_stream_error( ZipStream *zs )
+{
+	zs->state = ZIP_STREAM_STATE_ERROR;
+	return false;
+}
+
+// Copies input into the header until it holds 'needed' bytes. Returns true once it does.
+static bool zip_stream_gather( ZipStream *zs, const u8 **data, u64 *bytes, u64 needed )
+{
+	// Every record's lengths are 16 bit, the header is sized for the largest
+	assert( needed <= ZIP_STREAM_HEADER_SIZE );
+
+	if ( zs->headerSize < needed )
+	{
+		u64 take = min( needed - zs->headerSize, *bytes );
+		memcpy( zs->header + zs->headerSize, *data, take );
+		zs->headerSize += take;
+		*data += take;
+		*bytes -= take;
+	}
+
+	return zs->headerSize >= needed;
+}
+
+// Replaces sizes marked as 0xFFFFFFFF with the values from a zip64 extra field
+// @return true if the extra field has a zip64 entry
+static bool zip_stream_read_zip64_sizes( const u8 *extra, u64 extraBytes, u64 *uncompressedSize, u64 *compressedSize )
+{
+	while ( extraBytes >= 4 )
+	{
+		u16 id = read_u16_le( extra );
+		u16 size = read_u16_le( extra + 2 );
+
+		if ( 4 + (u64)size > extraBytes )
+			return false;
+
+		if ( id == ZIP_EXTRA_ZIP64 )
+		{
+			const u8 *p = extra + 4;
+			const u8 *end = p + size;
+
+			if ( *uncompressedSize == 0xFFFFFFFF && p + 8 <= end )
+			{
+				*uncompressedSize = read_u64_le( p );
+				p += 8;
+			}
+
+			if ( *compressedSize == 0xFFFFFFFF && p + 8 <= end )
+				*compressedSize = read_u64_le( p );
+
+			return true;
+		}
+
+		extra += 4 + size;
+		extraBytes -= 4 + size;
+	}
+
+	return false;
+}
+
+static bool zip_stream_output( ZipStream *zs, const u8 *data, u64 bytes )
+{
+	if ( bytes == 0 )
+		return true;
+
+	zs->runningCrc = crc32_z( zs->runningCrc, data, bytes );
+	zs->written += bytes;
+
+	if ( zs->file && fwrite( data, 1, bytes, zs->file ) != bytes )
+	{
+		log_error( "Failed writing extracted file: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	return true;
+}
+
+static bool zip_stream_finish_entry( ZipStream *zs )
+{
+	if ( zs->written != zs->uncompressedSize || zs->compressedRead != zs->compressedSize )
+	{
+		log_error( "Size mismatch for archive entry: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	if ( zs->runningCrc != zs->crc )
+	{
+		log_error( "CRC mismatch for archive entry: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	ZipStreamRecord record =
+	{
+		.crc = zs->crc,
+		.nameBytes = static_cast<u32>( string_utf8_bytes( zs->name ) - 1 ),
+		.compressedSize = zs->compressedSize,
+		.uncompressedSize = zs->uncompressedSize,
+	};
+
+	u64 padding = ( 8 - ( record.nameBytes & 7 ) ) & 7;
+	const u8 zeros[ 8 ] = {};
+
+	if ( !zs->records.append( &record, sizeof( record ) ) ||
+		!zs->records.append( zs->name, record.nameBytes ) ||
+		!zs->records.append( zeros, padding ) )
+	{
+		log_error( "Out of memory recording archive entries." );
+		return zip_stream_error( zs );
+	}
+
+	zs->entryCount += 1;
+	zs->state = ZIP_STREAM_STATE_SIGNATURE;
+	zs->headerSize = 0;
+
+	return true;
+}
+
+static bool zip_stream_finish_data( ZipStream *zs )
+{
+	if ( zs->file )
+	{
+		bool closed = close_file( zs->file, zs->syncFiles );
+		zs->file = nullptr;
+
+		if ( !closed )
+		{
+			log_error( "Failed writing extracted file: %s", zs->name );
+			return zip_stream_error( zs );
+		}
+	}
+
+	if ( zs->flags & ZIP_FLAG_DATA_DESCRIPTOR )
+	{
+		zs->state = ZIP_STREAM_STATE_DESCRIPTOR;
+		zs->headerSize = 0;
+		return true;
+	}
+
+	return zip_stream_finish_entry( zs );
+}
+
+static bool zip_stream_open_entry( ZipStream *zs )
+{
+	const u8 *h = zs->header;
+	u16 nameBytes = read_u16_le( h + 26 );
+	u16 extraBytes = read_u16_le( h + 28 );
+
+	zs->flags = read_u16_le( h + 6 );
+	zs->method = read_u16_le( h + 8 );
+	zs->crc = read_u32_le( h + 14 );
+	zs->compressedSize = read_u32_le( h + 18 );
+	zs->uncompressedSize = read_u32_le( h + 22 );
+	zs->zip64 = zip_stream_read_zip64_sizes( h + 30 + nameBytes, extraBytes, &zs->uncompressedSize, &zs->compressedSize );
+	zs->compressedRead = 0;
+	zs->written = 0;
+	zs->runningCrc = crc32( 0, nullptr, 0 );
+
+	if ( nameBytes == 0 || nameBytes >= sizeof( zs->name ) )
+	{
+		log_error( "Invalid archive entry name length: %d", nameBytes );
+		return zip_stream_error( zs );
+	}
+
+	string_utf8_copy( zs->name, (const char *)h + 30, nameBytes );
+
+	if ( zs->flags & ZIP_FLAG_ENCRYPTED )
+	{
+		log_error( "Encrypted archive entries are not supported: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	if ( zs->method != ZIP_CM_STORE && zs->method != ZIP_CM_DEFLATE )
+	{
+		log_error( "Unsupported compression method ( %d ) for: %s", zs->method, zs->name );
+		return zip_stream_error( zs );
+	}
+
+	// Without a size there is no way to find where stored data ends
+	if ( zs->method == ZIP_CM_STORE && ( zs->flags & ZIP_FLAG_DATA_DESCRIPTOR ) )
+	{
+		log_error( "Stored entry without a size cannot be streamed: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	if ( zs->entryCount == 0 )
+	{
+		zs->rootBytes = archive_root_bytes( zs->name );
+		string_utf8_copy( zs->root, zs->name, zs->rootBytes );
+	}
+
+	char filePath[ MAX_FILEPATH ];
+	string_utf8_copy( filePath, zs->path );
+	string_utf8_append( filePath, zs->name + archive_root_skip( zs->name, zs->root, zs->rootBytes ) );
+
+	bool folder = zs->name[ nameBytes - 1 ] == '/';
+
+	if ( folder )
+	{
+		if ( !make_directory( filePath ) )
+			return zip_stream_error( zs );
+	}
+	else
+	{
+		zs->file = fopen( filePath, "wb" );
+
+		// Zips don't always list the folders before their files
+		if ( !zs->file )
+		{
+			char *separator = strrchr( filePath, '/' );
+			*separator = '\0';
+
+			if ( make_directory( filePath ) )
+			{
+				*separator = '/';
+				zs->file = fopen( filePath, "wb" );
+			}
+
+			*separator = '/';
+		}
+
+		if ( !zs->file )
+		{
+			log_error( "Error opening file: %s", filePath );
+			return zip_stream_error( zs );
+		}
+	}
+
+	if ( zs->method == ZIP_CM_DEFLATE )
+	{
+		i32 result = zs->inflaterActive ? inflateReset( &zs->inflater ) : inflateInit2( &zs->inflater, -MAX_WBITS );
+		if ( result != Z_OK )
+		{
+			log_error( "Failed to initialise inflate for: %s", zs->name );
+			return zip_stream_error( zs );
+		}
+		zs->inflaterActive = true;
+	}
+
+	zs->state = ZIP_STREAM_STATE_DATA;
+	zs->headerSize = 0;
+
+	// Nothing to wait for
+	if ( zs->method == ZIP_CM_STORE && zs->compressedSize == 0 )
+		return zip_stream_finish_data( zs );
+
+	return true;
+}
+
+static bool zip_stream_data( ZipStream *zs, const u8 **data, u64 *bytes )
+{
+	if ( zs->method == ZIP_CM_STORE )
+	{
+		u64 take = min( zs->compressedSize - zs->compressedRead, *bytes );
+
+		if ( !zip_stream_output( zs, *data, take ) )
+			return false;
+
+		zs->compressedRead += take;
+		*data += take;
+		*bytes -= take;
+
+		if ( zs->compressedRead == zs->compressedSize )
+			return zip_stream_finish_data( zs );
+
+		return true;
+	}
+
+	// The deflate stream knows where it ends, so a trailing data descriptor is fine
+	bool knownSize = !( zs->flags & ZIP_FLAG_DATA_DESCRIPTOR );
+	u64 available = min( knownSize ? zs->compressedSize - zs->compressedRead : *bytes, min( *bytes, (u64)UINT32_MAX ) );
+	i32 result;
+
+	zs->inflater.next_in = (Bytef *)*data;
+	zs->inflater.avail_in = static_cast<uInt>( available );
+
+	do
+	{
+		zs->inflater.next_out = zs->output;
+		zs->inflater.avail_out = ZIP_STREAM_OUTPUT_SIZE;
+
+		result = inflate( &zs->inflater, Z_NO_FLUSH );
+
+		if ( result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR )
+		{
+			log_error( "Failed to inflate archive entry: %s", zs->name );
+			return zip_stream_error( zs );
+		}
+
+		if ( !zip_stream_output( zs, zs->output, ZIP_STREAM_OUTPUT_SIZE - zs->inflater.avail_out ) )
+			return false;
+	}
+	while ( result == Z_OK && ( zs->inflater.avail_in > 0 || zs->inflater.avail_out == 0 ) );
+
+	u64 consumed = available - zs->inflater.avail_in;
+	zs->compressedRead += consumed;
+	*data += consumed;
+	*bytes -= consumed;
+
+	if ( result == Z_STREAM_END )
+		return zip_stream_finish_data( zs );
+
+	if ( knownSize && zs->compressedRead == zs->compressedSize )
+	{
+		log_error( "Archive entry data ended early: %s", zs->name );
+		return zip_stream_error( zs );
+	}
+
+	return true;
+}
+
+static bool zip_stream_descriptor( ZipStream *zs, const u8 **data, u64 *bytes )
+{
+	if ( !zip_stream_gather( zs, data, bytes, 4 ) )
+		return true;
+
+	// The signature is optional
+	u64 signatureBytes = read_u32_le( zs->header ) == ZIP_SIGNATURE_DATA_DESCRIPTOR ? 4 : 0;
+
+	if ( !zip_stream_gather( zs, data, bytes, signatureBytes + 4 + ( zs->zip64 ? 16 : 8 ) ) )
+		return true;
+
+	const u8 *d = zs->header + signatureBytes;
+
+	zs->crc = read_u32_le( d );
+
+	if ( zs->zip64 )
+	{
+		zs->compressedSize = read_u64_le( d + 4 );
+		zs->uncompressedSize = read_u64_le( d + 12 );
+	}
+	else
+	{
+		zs->compressedSize = read_u32_le( d + 4 );
+		zs->uncompressedSize = read_u32_le( d + 8 );
+	}
+
+	return zip_stream_finish_entry( zs );
+}
+
+static bool zip_stream_verify_central_header( ZipStream *zs )
+{
+	const u8 *h = zs->header;
+	u16 nameBytes = read_u16_le( h + 28 );
+	u16 extraBytes = read_u16_le( h + 30 );
+	u32 crc = read_u32_le( h + 16 );
+	u64 compressedSize = read_u32_le( h + 20 );
+	u64 uncompressedSize = read_u32_le( h + 24 );
+	const char *name = (const char *)h + 46;
+
+	zip_stream_read_zip64_sizes( h + 46 + nameBytes, extraBytes, &uncompressedSize, &compressedSize );
+
+	if ( zs->verifyOffset + sizeof( ZipStreamRecord ) > zs->records.size )
+	{
+		log_error( "Central directory lists an entry that was not extracted: %.*s", nameBytes, name );
+		return zip_stream_error( zs );
+	}
+
+	ZipStreamRecord *record = (ZipStreamRecord *)( zs->records.data + zs->verifyOffset );
+	const char *recordName = (const char *)( record + 1 );
+
+	if ( record->nameBytes != nameBytes || memcmp( recordName, name, nameBytes ) != 0 ||
+		record->crc != crc || record->compressedSize != compressedSize || record->uncompressedSize != uncompressedSize )
+	{
+		log_error( "Central directory does not match extracted entry: %.*s", nameBytes, name );
+		return zip_stream_error( zs );
+	}
+
+	zs->verifyOffset += sizeof( ZipStreamRecord ) + ( ( record->nameBytes + 7 ) & ~7u );
+	zs->verifiedCount += 1;
+	zs->state = ZIP_STREAM_STATE_SIGNATURE;
+	zs->headerSize = 0;
+
+	return true;
+}
+
+bool zip_stream_begin( ZipStream *zs, Allocator *allocator, const char *path )
+{
+	*zs = {};
+
+	zs->state = ZIP_STREAM_STATE_SIGNATURE;
+	zs->allocator = allocator;
+	zs->path = path;
+	zs->header = allocator->allocate<u8>( ZIP_STREAM_HEADER_SIZE );
+	zs->output = allocator->allocate<u8>( ZIP_STREAM_OUTPUT_SIZE );
+	zs->records.allocator = allocator;
+
+	if ( !zs->header || !zs->output )
+	{
+		log_error( "Failed to allocate memory for streaming extraction." );
+		zip_stream_free( zs );
+		return false;
+	}
+
+	return make_directory( path );
+}
+
+bool zip_stream_write( ZipStream *zs, const u8 *data, u64 bytes )
+{
+	zs->bytesIn += bytes;
+
+	while ( bytes > 0 )
+	{
+		switch ( zs->state )
+		{
+			case ZIP_STREAM_STATE_SIGNATURE:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 4 ) )
+					break;
+
+				u32 signature = read_u32_le( zs->header );
+
+				if ( signature == ZIP_SIGNATURE_LOCAL_HEADER )
+					zs->state = ZIP_STREAM_STATE_LOCAL_HEADER;
+				else if ( signature == ZIP_SIGNATURE_CENTRAL_HEADER )
+					zs->state = ZIP_STREAM_STATE_CENTRAL_HEADER;
+				else if ( signature == ZIP_SIGNATURE_ZIP64_END )
+					zs->state = ZIP_STREAM_STATE_ZIP64_END;
+				else if ( signature == ZIP_SIGNATURE_ZIP64_LOCATOR )
+					zs->state = ZIP_STREAM_STATE_ZIP64_LOCATOR;
+				else if ( signature == ZIP_SIGNATURE_END )
+					zs->state = ZIP_STREAM_STATE_END;
+				else
+				{
+					log_error( "Unexpected signature in archive: 0x%08x", signature );
+					return zip_stream_error( zs );
+				}
+			}
+			break;
+
+			case ZIP_STREAM_STATE_LOCAL_HEADER:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 30 ) )
+					break;
+
+				u64 needed = 30 + read_u16_le( zs->header + 26 ) + read_u16_le( zs->header + 28 );
+
+				if ( zip_stream_gather( zs, &data, &bytes, needed ) && !zip_stream_open_entry( zs ) )
+					return false;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_DATA:
+			{
+				if ( !zip_stream_data( zs, &data, &bytes ) )
+					return false;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_DESCRIPTOR:
+			{
+				if ( !zip_stream_descriptor( zs, &data, &bytes ) )
+					return false;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_CENTRAL_HEADER:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 46 ) )
+					break;
+
+				u64 needed = 46 + read_u16_le( zs->header + 28 ) + read_u16_le( zs->header + 30 ) + read_u16_le( zs->header + 32 );
+
+				if ( zip_stream_gather( zs, &data, &bytes, needed ) && !zip_stream_verify_central_header( zs ) )
+					return false;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_ZIP64_END:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 12 ) )
+					break;
+
+				// Nothing needed from it, skip the rest of the record
+				zs->skipRemaining = read_u64_le( zs->header + 4 );
+				zs->state = ZIP_STREAM_STATE_SKIP;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_ZIP64_LOCATOR:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 20 ) )
+					break;
+
+				zs->state = ZIP_STREAM_STATE_SIGNATURE;
+				zs->headerSize = 0;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_SKIP:
+			{
+				u64 take = min( zs->skipRemaining, bytes );
+				zs->skipRemaining -= take;
+				data += take;
+				bytes -= take;
+
+				if ( zs->skipRemaining == 0 )
+				{
+					zs->state = ZIP_STREAM_STATE_SIGNATURE;
+					zs->headerSize = 0;
+				}
+			}
+			break;
+
+			case ZIP_STREAM_STATE_END:
+			{
+				if ( !zip_stream_gather( zs, &data, &bytes, 22 ) )
+					break;
+
+				u16 commentBytes = read_u16_le( zs->header + 20 );
+
+				if ( !zip_stream_gather( zs, &data, &bytes, 22 + commentBytes ) )
+					break;
+
+				string_utf8_copy( zs->comment, (const char *)zs->header + 22, min<u64>( commentBytes, sizeof( zs->comment ) - 1 ) );
+
+				zs->state = ZIP_STREAM_STATE_DONE;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_DONE:
+			{
+				// Anything after the end record is ignored
+				bytes = 0;
+			}
+			break;
+
+			case ZIP_STREAM_STATE_ERROR:
+			{
+				return false;
+			}
+		}
+	}
+
+	return zs->state != ZIP_STREAM_STATE_ERROR;
+}
+
+bool zip_stream_end( ZipStream *zs )
+{
+	if ( zs->state != ZIP_STREAM_STATE_DONE )
+	{
+		log_error( "Archive ended before the end of central directory record." );
+		return zip_stream_error( zs );
+	}
+
+	if ( zs->verifiedCount != zs->entryCount )
+	{
+		log_error( "Central directory lists %llu entries but %llu were extracted.", (unsigned long long)zs->verifiedCount, (unsigned long long)zs->entryCount );
+		return zip_stream_error( zs );
+	}
+
+	return true;
+}
+
+void zip_stream_free( ZipStream *zs )
+{
+	if ( zs->file )
+	{
+		fclose( zs->file );
+		zs->file = nullptr;
+	}
+
+	if ( zs->inflaterActive )
+	{
+		inflateEnd( &zs->inflater );
+		zs->inflaterActive = false;
+	}
+
+	// Reverse order of allocation so the bump allocator can rewind
+	zs->records.free();
+
+	if ( zs->output )
+		zs->allocator->free( zs->output );
+
+	if ( zs->header )
+		zs->allocator->free( zs->header );
+
+	zs->output = nullptr;
+	zs->header = nullptr;
+}
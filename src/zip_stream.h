@@ -0,0 +1,111 @@
+#pragma once
+
+#define ZIP_STREAM_OUTPUT_SIZE		( KB( 64 ) )
+// The largest record gathered whole, a central directory header with the longest name, extra field and comment
+#define ZIP_STREAM_HEADER_SIZE		( (u64)46 + 0xFFFF + 0xFFFF + 0xFFFF )
+#define ZIP_STREAM_MAX_NAME			( 4096 )
+#define ZIP_STREAM_MAX_COMMENT		( 256 )
+
+constexpr const u32 ZIP_SIGNATURE_LOCAL_HEADER = 0x04034b50;
+constexpr const u32 ZIP_SIGNATURE_DATA_DESCRIPTOR = 0x08074b50;
+constexpr const u32 ZIP_SIGNATURE_CENTRAL_HEADER = 0x02014b50;
+constexpr const u32 ZIP_SIGNATURE_END = 0x06054b50;
+constexpr const u32 ZIP_SIGNATURE_ZIP64_END = 0x06064b50;
+constexpr const u32 ZIP_SIGNATURE_ZIP64_LOCATOR = 0x07064b50;
+
+constexpr const u16 ZIP_FLAG_ENCRYPTED = 1 << 0;
+constexpr const u16 ZIP_FLAG_DATA_DESCRIPTOR = 1 << 3;
+constexpr const u16 ZIP_EXTRA_ZIP64 = 0x0001;
+
+[[nodiscard]] inline u16 read_u16_le( const u8 *p )
+{
+	return static_cast<u16>( p[ 0 ] | ( p[ 1 ] << 8 ) );
+}
+
+[[nodiscard]] inline u32 read_u32_le( const u8 *p )
+{
+	return static_cast<u32>( p[ 0 ] ) | ( static_cast<u32>( p[ 1 ] ) << 8 ) | ( static_cast<u32>( p[ 2 ] ) << 16 ) | ( static_cast<u32>( p[ 3 ] ) << 24 );
+}
+
+[[nodiscard]] inline u64 read_u64_le( const u8 *p )
+{
+	return static_cast<u64>( read_u32_le( p ) ) | ( static_cast<u64>( read_u32_le( p + 4 ) ) << 32 );
+}
+
+enum ZIP_STREAM_STATE
+{
+	ZIP_STREAM_STATE_SIGNATURE,
+	ZIP_STREAM_STATE_LOCAL_HEADER,
+	ZIP_STREAM_STATE_DATA,
+	ZIP_STREAM_STATE_DESCRIPTOR,
+	ZIP_STREAM_STATE_CENTRAL_HEADER,
+	ZIP_STREAM_STATE_ZIP64_END,
+	ZIP_STREAM_STATE_ZIP64_LOCATOR,
+	ZIP_STREAM_STATE_END,
+	ZIP_STREAM_STATE_SKIP,
+	ZIP_STREAM_STATE_DONE,
+	ZIP_STREAM_STATE_ERROR,
+};
+
+// What was extracted for an entry, checked against the central directory at the end.
+// Followed in memory by the name bytes, padded to 8 bytes.
+struct ZipStreamRecord
+{
+	u32 crc;
+	u32 nameBytes;
+	u64 compressedSize;
+	u64 uncompressedSize;
+};
+
+// Extracts a zip archive as its bytes arrive, without needing the central directory first.
+struct ZipStream
+{
+	ZIP_STREAM_STATE state;
+	Allocator *allocator;
+	const char *path;
+
+	// Named by the first entry, left out of every path inside it
+	char root[ ZIP_STREAM_MAX_NAME ];
+	u64 rootBytes;
+
+	// Fixed size headers are gathered here until complete
+	u8 *header;
+	u64 headerSize;
+	u64 skipRemaining;
+
+	// Current entry
+	char name[ ZIP_STREAM_MAX_NAME ];
+	u16 flags;
+	u16 method;
+	u32 crc;
+	u64 compressedSize;
+	u64 uncompressedSize;
+	u64 compressedRead;
+	u64 written;
+	u32 runningCrc;
+	bool zip64;
+	FILE *file;
+
+	// Set after zip_stream_begin, each extracted file is flushed to the disk as it is closed
+	bool syncFiles;
+
+	z_stream inflater;
+	bool inflaterActive;
+	u8 *output;
+
+	// Extracted entries, verified against the central directory
+	Buffer records;
+	u64 entryCount;
+	u64 verifyOffset;
+	u64 verifiedCount;
+
+	// Bytes of the archive received so far, where a resumed download continues from
+	u64 bytesIn;
+
+	char comment[ ZIP_STREAM_MAX_COMMENT ];
+};
+
+bool zip_stream_begin( ZipStream *zs, Allocator *allocator, const char *path );
+bool zip_stream_write( ZipStream *zs, const u8 *data, u64 bytes );
+bool zip_stream_end( ZipStream *zs );
+void zip_stream_free( ZipStream *zs );
@@ -0,0 +1,67 @@
+# Extracts a zip of more than 100k entries, served over http from a temporary folder, with each zip reader.
+# usage: large_archive.py <template-downloader>
+import functools
+import http.server
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+import zipfile
+
+FILE_COUNT = 100_500
+FILES_PER_FOLDER = 200
+
+def make_archive( path ):
+	with zipfile.ZipFile( path, "w", zipfile.ZIP_DEFLATED ) as archive:
+		archive.writestr( "large-master/", "" )
+		archive.writestr( "large-master/run.bat", "echo __GAME_TEMPLATE_NAME__\n" )
+		archive.writestr( "large-master/build.bat", "echo build\n" )
+
+		# No folder entries, every folder is made from the files' paths
+		for i in range( FILE_COUNT ):
+			archive.writestr( "large-master/d%d/sub/f%d.txt" % ( i // FILES_PER_FOLDER, i ), "file %d\n" % i )
+
+class QuietHandler( http.server.SimpleHTTPRequestHandler ):
+	def log_message( self, *args ):
+		pass
+
+def count_files( folder ):
+	return sum( len( files ) for _, _, files in os.walk( folder ) )
+
+def main():
+	binary = os.path.abspath( sys.argv[ 1 ] )
+
+	with tempfile.TemporaryDirectory() as root:
+		served = os.path.join( root, "served" )
+		os.makedirs( served )
+		make_archive( os.path.join( served, "large.zip" ) )
+
+		handler = functools.partial( QuietHandler, directory = served )
+		server = http.server.ThreadingHTTPServer( ( "127.0.0.1", 0 ), handler )
+		threading.Thread( target = server.serve_forever, daemon = True ).start()
+		url = "http://127.0.0.1:%d/large.zip" % server.server_address[ 1 ]
+
+		failed = False
+
+		for reader in ( "libzip", "map" ):
+			dest = os.path.join( root, reader ) + "/"
+			os.makedirs( dest )
+
+			result = subprocess.run( [ binary, "-p", "large", "-o", dest, "-s", url, "-zip-reader", reader ], capture_output = True, text = True )
+			found = count_files( os.path.join( dest, "large" ) ) if result.returncode == 0 else 0
+			expected = FILE_COUNT + 2
+
+			if result.returncode != 0 or found != expected:
+				print( "%s: exit code %d, %d of %d files" % ( reader, result.returncode, found, expected ) )
+				print( result.stdout + result.stderr )
+				failed = True
+			else:
+				print( "%s: %d files" % ( reader, found ) )
+
+		server.shutdown()
+
+	return 1 if failed else 0
+
+if __name__ == "__main__":
+	sys.exit( main() )